@@ -0,0 +1,279 @@
+#include <benchmark.h>
+#include <blit.h>
+#include <font.h>
+#include <image.h>
+#include <nonstddef.h>
+#include <platform.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <text-cache.h>
+#include <virtio.h>
+
+
+#ifndef BENCHMARK
+
+void run_benchmarks(void)
+{
+}
+
+#else // BENCHMARK
+
+static uint32_t *scratch;
+static int scratch_w, scratch_h;
+static size_t scratch_stride;
+
+
+static uint64_t time_blits(const uint32_t *img, int w, int h, int iterations)
+{
+    uint64_t start = platform_funcs.elapsed_us();
+
+    for (int i = 0; i < iterations; i++) {
+        // Move the sprite around a bit so we do not just measure the
+        // same few cache lines over and over again
+        int dx = w < scratch_w ? (i * 97) % (scratch_w - w) : 0;
+        int dy = h < scratch_h ? (i * 61) % (scratch_h - h) : 0;
+
+        ablitlmt(scratch, (uint32_t *)img, dx, dy, w, h, scratch_stride,
+                 w * sizeof(uint32_t), 0, 0, scratch_w, scratch_h);
+    }
+
+    return platform_funcs.elapsed_us() - start;
+}
+
+
+static uint64_t time_span_blits(const SpanImage *img, int iterations)
+{
+    uint64_t start = platform_funcs.elapsed_us();
+
+    for (int i = 0; i < iterations; i++) {
+        int dx = img->w < scratch_w ? (i * 97) % (scratch_w - img->w) : 0;
+        int dy = img->h < scratch_h ? (i * 61) % (scratch_h - img->h) : 0;
+
+        sblitlmt(scratch, img, dx, dy, scratch_stride,
+                 0, 0, scratch_w, scratch_h);
+    }
+
+    return platform_funcs.elapsed_us() - start;
+}
+
+
+static uint64_t time_indexed_blits(const IndexedImage *img, int iterations)
+{
+    uint64_t start = platform_funcs.elapsed_us();
+
+    for (int i = 0; i < iterations; i++) {
+        int dx = img->w < scratch_w ? (i * 97) % (scratch_w - img->w) : 0;
+        int dy = img->h < scratch_h ? (i * 61) % (scratch_h - img->h) : 0;
+
+        iblitlmt(scratch, img, dx, dy, scratch_stride,
+                 0, 0, scratch_w, scratch_h);
+    }
+
+    return platform_funcs.elapsed_us() - start;
+}
+
+
+static void bench_blit_image(const char *name, int iterations)
+{
+    uint32_t *img = NULL;
+    int w = 0, h = 0;
+
+    if (!load_image(name, &img, &w, &h, 0)) {
+        printf("[bench] %s: Failed to load\n", name);
+        return;
+    }
+
+    ABlitRowFunc selected = ablit_row;
+
+    ablit_row = ablit_row_scalar;
+    uint64_t scalar_us = time_blits(img, w, h, iterations);
+
+    printf("[bench] blit %s (%ix%i, %ix): scalar %zu us",
+           name, w, h, iterations, (size_t)scalar_us);
+
+    if (blit_have_rvv()) {
+        ablit_row = ablit_row_rvv;
+        uint64_t rvv_us = time_blits(img, w, h, iterations);
+
+        printf(", rvv %zu us (speedup %zu %%)", (size_t)rvv_us,
+               (size_t)(scalar_us * 100 / (rvv_us ? rvv_us : 1)));
+    }
+
+    SpanImage simg;
+    if (!span_encode_image(img, w, h, &simg)) {
+        printf("\n[bench] %s: Failed to span-encode\n", name);
+        ablit_row = selected;
+        free(img);
+        return;
+    }
+    uint64_t span_us = time_span_blits(&simg, iterations);
+
+    printf(", spans %zu us (%zu spans, %zu %% of the pixels stored)",
+           (size_t)span_us, (size_t)simg.rows[h].span,
+           (size_t)simg.rows[h].pixel * 100 / (w * h));
+    free_span_image(&simg);
+
+    IndexedImage iimg;
+    if (index_image(img, w, h, w * sizeof(uint32_t), &iimg)) {
+        uint64_t indexed_us = time_indexed_blits(&iimg, iterations);
+
+        printf(", indexed %zu us (%i colors)", (size_t)indexed_us,
+               iimg.colors);
+        free_indexed_image(&iimg);
+    }
+
+    putchar('\n');
+
+    ablit_row = selected;
+    free(img);
+}
+
+
+static void bench_blit(void)
+{
+    bench_blit_image("/army-token.png", 2000);
+    bench_blit_image("/army-none.png", 2000);
+    bench_blit_image("/focus-region.png", 2000);
+    bench_blit_image("/die-6.png", 2000);
+    bench_blit_image("/battle.png", 2000);
+    bench_blit_image("/victory.png", 10);
+    bench_blit_image("/defeat.png", 10);
+}
+
+
+static const char *const status_strings[] = {
+    "Choose a region to attack from.",
+    "Press the space bar to end the battle phase.",
+    "Reinforce your regions by placing two additional armies per turn.",
+    "You have 12 armies remaining.",
+    "Choose how many armies you want to attack with (1, 2, or 3).",
+    "Attacker lost 1 army, defender lost 2 armies.",
+};
+
+
+static void bench_font(void)
+{
+    const int iterations = 1000;
+
+    // Same layout as the status column
+    int x = scratch_w - 280;
+    size_t chars = 0;
+
+    uint64_t start = platform_funcs.elapsed_us();
+
+    for (int i = 0; i < iterations; i++) {
+        for (int j = 0; j < (int)ARRAY_SIZE(status_strings); j++) {
+            font_draw_text(scratch, scratch_w, scratch_h, scratch_stride,
+                           x, 60 + j * 40, status_strings[j], 0);
+            chars += strlen(status_strings[j]);
+        }
+    }
+
+    uint64_t us = platform_funcs.elapsed_us() - start;
+
+    printf("[bench] status text (%zu chars): %zu us (%zu chars/ms)\n",
+           chars, (size_t)us, (size_t)(chars * 1000 / (us ? us : 1)));
+}
+
+
+static void bench_text_cache(void)
+{
+    const int iterations = 1000;
+
+    int x = scratch_w - 280;
+    size_t chars = 0;
+
+    uint64_t start = platform_funcs.elapsed_us();
+
+    for (int i = 0; i < iterations; i++) {
+        for (int j = 0; j < (int)ARRAY_SIZE(status_strings); j++) {
+            text_cache_draw(scratch, scratch_w, scratch_h, scratch_stride,
+                            x, 60 + j * 40, status_strings[j], 0);
+            chars += strlen(status_strings[j]);
+        }
+    }
+
+    uint64_t us = platform_funcs.elapsed_us() - start;
+
+    TextCacheStats stats;
+    text_cache_get_stats(&stats);
+
+    printf("[bench] cached status text (%zu chars): %zu us (%zu chars/ms), "
+           "%zu hits, %zu misses\n",
+           chars, (size_t)us, (size_t)(chars * 1000 / (us ? us : 1)),
+           (size_t)stats.hits, (size_t)stats.misses);
+}
+
+
+static uint64_t time_flushes(const FBRect *rect, int iterations)
+{
+    uint64_t start = platform_funcs.elapsed_us();
+
+    for (int i = 0; i < iterations; i++) {
+        fb_flush_rects(rect, 1);
+        // Flushing alone only collects damage until the next frame
+        platform_funcs.fb_present();
+    }
+
+    return platform_funcs.elapsed_us() - start;
+}
+
+
+// Run once with virtio-gpu and once with ramfb to compare the two
+static void bench_flush(void)
+{
+    const int iterations = 200;
+
+    FBRect full = { .x = 0, .y = 0, .w = scratch_w, .h = scratch_h };
+    FBRect small = { .x = scratch_w / 2, .y = scratch_h / 2, .w = 64, .h = 64 };
+
+    VirtIOStats before, after;
+    virtio_get_stats(&before);
+
+    uint64_t full_us = time_flushes(&full, iterations);
+    uint64_t small_us = time_flushes(&small, iterations);
+
+    virtio_get_stats(&after);
+
+    printf("[bench] flush (%ix): full screen %zu us/flush, "
+           "64x64 %zu us/flush\n", iterations,
+           (size_t)(full_us / iterations), (size_t)(small_us / iterations));
+
+    // Stays at zero with ramfb
+    printf("[bench] flush: %zu virtio notifications, %zu suppressed\n",
+           (size_t)(after.notifications - before.notifications),
+           (size_t)(after.suppressed_notifications -
+                    before.suppressed_notifications));
+}
+
+
+void run_benchmarks(void)
+{
+    scratch_w = platform_funcs.fb_width();
+    scratch_h = platform_funcs.fb_height();
+    scratch_stride = platform_funcs.fb_stride();
+
+    scratch = malloc(scratch_h * scratch_stride);
+    if (!scratch) {
+        puts("[bench] Failed to allocate scratch buffer, skipping benchmarks");
+        return;
+    }
+    memset(scratch, 0, scratch_h * scratch_stride);
+
+    puts("[bench] Starting benchmarks");
+
+    bench_blit();
+    bench_font();
+    bench_text_cache();
+    bench_flush();
+
+    puts("[bench] Done");
+
+    free(scratch);
+    scratch = NULL;
+}
+
+#endif // BENCHMARK
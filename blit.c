@@ -0,0 +1,185 @@
+#include <blit.h>
+#include <cpu.h>
+#include <nonstddef.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+
+ABlitRowFunc ablit_row = ablit_row_scalar;
+
+static bool have_rvv;
+
+
+void init_blit(void)
+{
+    if (!cpu_has_extension('V')) {
+        puts("[blit] Using scalar blend kernel");
+        return;
+    }
+
+    // The vector unit is off after reset; any vector instruction
+    // would trap until we switch it on
+    set_csr_bits(CSR_MSTATUS, MSTATUS_VS_INITIAL);
+
+    have_rvv = true;
+    ablit_row = ablit_row_rvv;
+
+    puts("[blit] Using RVV blend kernel");
+}
+
+
+bool blit_have_rvv(void)
+{
+    return have_rvv;
+}
+
+
+void ablit_row_scalar(uint32_t *dst, const uint32_t *src, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        uint32_t s, *d, a, rb, g;
+
+        s = src[i];
+        d = &dst[i];
+
+        // Spread a to 0..256 so we can lsr 8 instead of div 0xff
+        a = (s >> 24) + (s >> 31);
+        rb = *d & 0xff00ff;
+        g = *d & 0x00ff00;
+        rb = ((((s & 0xff00ff) - rb) * a) + (rb << 8)) >> 8;
+        g = ((((s & 0x00ff00) - g) * a) + (g << 8)) >> 8;
+        *d = (rb & 0xff00ff) | (g & 0x00ff00) | 0xff000000;
+    }
+}
+
+
+void ablitlmt(uint32_t *dst, uint32_t *src, int dx, int dy,
+              int sw, int sh, size_t dstride, size_t sstride,
+              int xmin, int ymin, int xmax, int ymax)
+{
+    int sx_start = MAX(xmin - dx, 0);
+    int sx_end = MIN(xmax - dx, sw);
+
+    int sy_start = MAX(ymin - dy, 0);
+    int sy_end = MIN(ymax - dy, sh);
+
+    if (sx_end <= sx_start) {
+        return;
+    }
+
+    for (int sy = sy_start; sy < sy_end; sy++) {
+        ablit_row((uint32_t *)((char *)dst + (dy + sy) * dstride)
+                      + dx + sx_start,
+                  (uint32_t *)((char *)src + sy * sstride) + sx_start,
+                  sx_end - sx_start);
+    }
+}
+
+
+// Blends the premultiplied pixel @s over @d
+static inline uint32_t blend_premul(uint32_t d, uint32_t s)
+{
+    // Same spread as above, but we need 256 - a
+    uint32_t ia = 256 - ((s >> 24) + (s >> 31));
+    uint32_t rb = (((d & 0xff00ff) * ia) >> 8) & 0xff00ff;
+    uint32_t g = (((d & 0x00ff00) * ia) >> 8) & 0x00ff00;
+    return ((s & 0xffffff) + rb + g) | 0xff000000;
+}
+
+
+void ablit_row_premul(uint32_t *dst, const uint32_t *src, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        dst[i] = blend_premul(dst[i], src[i]);
+    }
+}
+
+
+void iblit_row(uint32_t *dst, const uint8_t *src, const uint32_t *lut,
+               size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        uint32_t s = lut[src[i]];
+        uint32_t a = s >> 24;
+
+        // Sprites are mostly fully transparent or fully opaque
+        if (a == 0xff) {
+            dst[i] = s;
+        } else if (a) {
+            dst[i] = blend_premul(dst[i], s);
+        }
+    }
+}
+
+
+void iblitlmt(uint32_t *dst, const IndexedImage *src, int dx, int dy,
+              size_t dstride, int xmin, int ymin, int xmax, int ymax)
+{
+    int sx_start = MAX(xmin - dx, 0);
+    int sx_end = MIN(xmax - dx, src->w);
+
+    int sy_start = MAX(ymin - dy, 0);
+    int sy_end = MIN(ymax - dy, src->h);
+
+    if (sx_end <= sx_start) {
+        return;
+    }
+
+    for (int sy = sy_start; sy < sy_end; sy++) {
+        iblit_row((uint32_t *)((char *)dst + (dy + sy) * dstride)
+                      + dx + sx_start,
+                  src->pixels + sy * src->w + sx_start,
+                  src->lut, sx_end - sx_start);
+    }
+}
+
+
+void sblitlmt(uint32_t *dst, const SpanImage *src, int dx, int dy,
+              size_t dstride, int xmin, int ymin, int xmax, int ymax)
+{
+    int sx_start = MAX(xmin - dx, 0);
+    int sx_end = MIN(xmax - dx, src->w);
+
+    int sy_start = MAX(ymin - dy, 0);
+    int sy_end = MIN(ymax - dy, src->h);
+
+    if (sx_end <= sx_start) {
+        return;
+    }
+
+    for (int sy = sy_start; sy < sy_end; sy++) {
+        uint32_t *drow = (uint32_t *)((char *)dst + (dy + sy) * dstride) + dx;
+        const uint32_t *pixels = src->pixels + src->rows[sy].pixel;
+
+        int x = 0;
+        for (uint32_t si = src->rows[sy].span;
+             si < src->rows[sy + 1].span && x < sx_end;
+             si++)
+        {
+            enum SpanType type = SPAN_TYPE(src->spans[si]);
+            int len = SPAN_LENGTH(src->spans[si]);
+
+            // Clip this run to [sx_start, sx_end)
+            int start = MAX(x, sx_start);
+            int end = MIN(x + len, sx_end);
+
+            if (start < end) {
+                const uint32_t *sp = pixels + (start - x);
+
+                if (type == SPAN_OPAQUE) {
+                    memcpy(drow + start, sp, (end - start) * sizeof(uint32_t));
+                } else if (type == SPAN_BLEND) {
+                    ablit_row_premul(drow + start, sp, end - start);
+                }
+            }
+
+            if (type != SPAN_SKIP) {
+                pixels += len;
+            }
+            x += len;
+        }
+    }
+}
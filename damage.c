@@ -0,0 +1,93 @@
+#include <damage.h>
+#include <nonstddef.h>
+#include <stdbool.h>
+
+
+void damage_init(DamageList *dl, int width, int height)
+{
+    *dl = (DamageList){
+        .width = width,
+        .height = height,
+    };
+}
+
+
+static int rect_area(const DamageRect *r)
+{
+    return (r->xmax - r->xmin) * (r->ymax - r->ymin);
+}
+
+static DamageRect rect_union(const DamageRect *a, const DamageRect *b)
+{
+    return (DamageRect){
+        .xmin = MIN(a->xmin, b->xmin),
+        .ymin = MIN(a->ymin, b->ymin),
+        .xmax = MAX(a->xmax, b->xmax),
+        .ymax = MAX(a->ymax, b->ymax),
+    };
+}
+
+static bool rects_intersect(const DamageRect *a, const DamageRect *b)
+{
+    return a->xmin < b->xmax && b->xmin < a->xmax &&
+           a->ymin < b->ymax && b->ymin < a->ymax;
+}
+
+// Number of pixels that would be redrawn needlessly if @a and @b were
+// merged
+static int merge_waste(const DamageRect *a, const DamageRect *b)
+{
+    DamageRect u = rect_union(a, b);
+    return rect_area(&u) - rect_area(a) - rect_area(b);
+}
+
+
+void damage_add(DamageList *dl, int xmin, int ymin, int xmax, int ymax)
+{
+    DamageRect r = {
+        .xmin = MAX(xmin, 0),
+        .ymin = MAX(ymin, 0),
+        .xmax = MIN(xmax, dl->width),
+        .ymax = MIN(ymax, dl->height),
+    };
+
+    if (r.xmin >= r.xmax || r.ymin >= r.ymax) {
+        return;
+    }
+
+    for (;;) {
+        int best_i = -1, best_waste = 0;
+
+        for (int i = 0; i < dl->count; i++) {
+            // Overlapping rectangles are always merged so the list
+            // stays disjoint (their waste is negative anyway if one
+            // contains the other)
+            int waste = merge_waste(&dl->rects[i], &r);
+            if (rects_intersect(&dl->rects[i], &r) ||
+                waste < DAMAGE_RECT_COST)
+            {
+                best_i = i;
+                break;
+            }
+
+            // No room left, so we will have to merge with something;
+            // find what is cheapest
+            if (dl->count == DAMAGE_MAX_RECTS &&
+                (best_i < 0 || waste < best_waste))
+            {
+                best_i = i;
+                best_waste = waste;
+            }
+        }
+
+        if (best_i < 0) {
+            dl->rects[dl->count++] = r;
+            return;
+        }
+
+        // Take the merged rectangle out and try to add it again,
+        // because it may now overlap others
+        r = rect_union(&dl->rects[best_i], &r);
+        dl->rects[best_i] = dl->rects[--dl->count];
+    }
+}
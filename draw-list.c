@@ -0,0 +1,266 @@
+#include <assert.h>
+#include <blit.h>
+#include <damage.h>
+#include <draw-list.h>
+#include <image.h>
+#include <nonstddef.h>
+#include <platform.h>
+#include <smp.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+
+typedef struct DrawJob {
+    const DrawList *dl;
+    // Indices into dl->ops, in execution order, without culled ops
+    const int *order;
+    int count;
+
+    DamageRect rect;
+    uint32_t *fb;
+    size_t stride;
+} DrawJob;
+
+
+static bool rect_empty(const DamageRect *r)
+{
+    return r->xmin >= r->xmax || r->ymin >= r->ymax;
+}
+
+static DamageRect rect_intersect(const DamageRect *a, const DamageRect *b)
+{
+    return (DamageRect){
+        .xmin = MAX(a->xmin, b->xmin),
+        .ymin = MAX(a->ymin, b->ymin),
+        .xmax = MIN(a->xmax, b->xmax),
+        .ymax = MIN(a->ymax, b->ymax),
+    };
+}
+
+static bool rect_contains(const DamageRect *outer, const DamageRect *inner)
+{
+    return inner->xmin >= outer->xmin && inner->ymin >= outer->ymin &&
+           inner->xmax <= outer->xmax && inner->ymax <= outer->ymax;
+}
+
+
+void draw_list_init(DrawList *dl, int width, int height)
+{
+    dl->width = width;
+    dl->height = height;
+    dl->op_count = 0;
+    draw_set_clip(dl, 0, 0, width, height);
+    damage_init(&dl->damage, width, height);
+}
+
+
+void draw_set_clip(DrawList *dl, int xmin, int ymin, int xmax, int ymax)
+{
+    dl->clip = (DamageRect){
+        .xmin = MAX(xmin, 0),
+        .ymin = MAX(ymin, 0),
+        .xmax = MIN(xmax, dl->width),
+        .ymax = MIN(ymax, dl->height),
+    };
+}
+
+
+void draw_damage(DrawList *dl, int xmin, int ymin, int xmax, int ymax)
+{
+    damage_add(&dl->damage, xmin, ymin, xmax, ymax);
+}
+
+
+static void add_op(DrawList *dl, const DrawOp *op)
+{
+    DamageRect rect = rect_intersect(&op->rect, &dl->clip);
+    if (rect_empty(&rect)) {
+        return;
+    }
+
+    assert(dl->op_count < DRAW_LIST_MAX_OPS);
+
+    DrawOp *new_op = &dl->ops[dl->op_count];
+    *new_op = *op;
+    new_op->rect = rect;
+    new_op->seq = dl->op_count++;
+}
+
+
+void draw_copy(DrawList *dl, int layer, const uint32_t *src, size_t stride)
+{
+    add_op(dl, &(DrawOp){
+        .type = DRAW_COPY,
+        .layer = layer,
+        .rect = dl->clip,
+        .stride = stride,
+        .img = src,
+    });
+}
+
+
+void draw_span(DrawList *dl, int layer, const SpanImage *img, int x, int y)
+{
+    add_op(dl, &(DrawOp){
+        .type = DRAW_SPAN,
+        .layer = layer,
+        .rect = { x, y, x + img->w, y + img->h },
+        .x = x,
+        .y = y,
+        .span_img = img,
+    });
+}
+
+
+void draw_blend(DrawList *dl, int layer, const uint32_t *img, int w, int h,
+                int x, int y)
+{
+    add_op(dl, &(DrawOp){
+        .type = DRAW_BLEND,
+        .layer = layer,
+        .rect = { x, y, x + w, y + h },
+        .x = x,
+        .y = y,
+        .w = w,
+        .h = h,
+        .stride = w * sizeof(uint32_t),
+        .img = img,
+    });
+}
+
+
+static void execute_op(const DrawOp *op, const DamageRect *r,
+                       uint32_t *fb, size_t stride)
+{
+    DamageRect c = rect_intersect(&op->rect, r);
+    if (rect_empty(&c)) {
+        return;
+    }
+
+    switch (op->type) {
+        case DRAW_COPY:
+            for (int y = c.ymin; y < c.ymax; y++) {
+                memcpy((char *)fb + y * stride + c.xmin * sizeof(uint32_t),
+                       (const char *)op->img + y * op->stride
+                           + c.xmin * sizeof(uint32_t),
+                       (c.xmax - c.xmin) * sizeof(uint32_t));
+            }
+            break;
+
+        case DRAW_SPAN:
+            sblitlmt(fb, op->span_img, op->x, op->y, stride,
+                     c.xmin, c.ymin, c.xmax, c.ymax);
+            break;
+
+        case DRAW_BLEND:
+            ablitlmt(fb, (uint32_t *)op->img, op->x, op->y, op->w, op->h,
+                     stride, op->stride, c.xmin, c.ymin, c.xmax, c.ymax);
+            break;
+    }
+}
+
+
+// Executes one horizontal band of the job's rectangle per hart
+static void execute_band(void *arg, int index, int count)
+{
+    const DrawJob *job = arg;
+    const DamageRect *r = &job->rect;
+    int h = r->ymax - r->ymin;
+
+    DamageRect band = {
+        .xmin = r->xmin,
+        .ymin = r->ymin + h * index / count,
+        .xmax = r->xmax,
+        .ymax = r->ymin + h * (index + 1) / count,
+    };
+
+    if (rect_empty(&band)) {
+        return;
+    }
+
+    for (int i = 0; i < job->count; i++) {
+        execute_op(&job->dl->ops[job->order[i]], &band, job->fb, job->stride);
+    }
+}
+
+
+static bool op_before(const DrawOp *a, const DrawOp *b)
+{
+    return a->layer != b->layer ? a->layer < b->layer : a->seq < b->seq;
+}
+
+
+void draw_list_execute(DrawList *dl, uint32_t *fb, size_t stride)
+{
+    int sorted[DRAW_LIST_MAX_OPS];
+
+    // Insertion sort, there are only a handful of ops
+    for (int i = 0; i < dl->op_count; i++) {
+        int j = i;
+        while (j > 0 && op_before(&dl->ops[i], &dl->ops[sorted[j - 1]])) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = i;
+    }
+
+    FBRect flush[DAMAGE_MAX_RECTS];
+
+    for (int ri = 0; ri < dl->damage.count; ri++) {
+        const DamageRect *r = &dl->damage.rects[ri];
+
+        // Only the ops that touch this rectangle, and of those only
+        // the ones not hidden below the topmost covering opaque one
+        int order[DRAW_LIST_MAX_OPS], count = 0;
+        for (int i = dl->op_count - 1; i >= 0; i--) {
+            const DrawOp *op = &dl->ops[sorted[i]];
+            DamageRect c = rect_intersect(&op->rect, r);
+            if (rect_empty(&c)) {
+                continue;
+            }
+
+            order[count++] = sorted[i];
+            if (op->type == DRAW_COPY && rect_contains(&op->rect, r)) {
+                break;
+            }
+        }
+
+        // Collected top-down, execute bottom-up
+        for (int i = 0; i < count / 2; i++) {
+            int tmp = order[i];
+            order[i] = order[count - 1 - i];
+            order[count - 1 - i] = tmp;
+        }
+
+        DrawJob job = {
+            .dl = dl,
+            .order = order,
+            .count = count,
+            .rect = *r,
+            .fb = fb,
+            .stride = stride,
+        };
+
+        int area = (r->xmax - r->xmin) * (r->ymax - r->ymin);
+        if (count && area >= DRAW_LIST_PARALLEL_MIN_PIXELS) {
+            smp_run(execute_band, &job);
+        } else {
+            execute_band(&job, 0, 1);
+        }
+
+        flush[ri] = (FBRect){
+            .x = r->xmin,
+            .y = r->ymin,
+            .w = r->xmax - r->xmin,
+            .h = r->ymax - r->ymin,
+        };
+    }
+
+    if (dl->damage.count) {
+        fb_flush_rects(flush, dl->damage.count);
+    }
+
+    draw_list_init(dl, dl->width, dl->height);
+}
@@ -1,6 +1,7 @@
 #include <assert.h>
 #include <ctype.h>
 #include <font.h>
+#include <limits.h>
 #include <nonstddef.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -28,6 +29,16 @@ static const struct NPF *font;
 static int char_sz, chars;
 static uint16_t char_indices[256];
 
+// Glyph cache: For every entry in char_indices, font->height masks
+// (one per row) where bit n set means that pixel n is set
+static uint32_t *glyph_masks;
+
+
+static inline struct NPFChar *get_char(int index)
+{
+    return (struct NPFChar *)((char *)(font + 1) + index * char_sz);
+}
+
 
 void init_font(void)
 {
@@ -52,12 +63,26 @@ void init_font(void)
         }
         c = (const struct NPFChar *)((char *)c + char_sz);
     }
-}
 
+    assert(font->width <= 32);
 
-static inline struct NPFChar *get_char(int index)
-{
-    return (struct NPFChar *)((char *)(font + 1) + index * char_sz);
+    int ymult = DIV_ROUND_UP(font->width, 8);
+    glyph_masks = calloc(ARRAY_SIZE(char_indices) * font->height,
+                         sizeof(glyph_masks[0]));
+
+    for (int chr = 0; chr < (int)ARRAY_SIZE(char_indices); chr++) {
+        c = get_char(char_indices[chr]);
+
+        for (int yofs = 0; yofs < font->height; yofs++) {
+            uint32_t mask = 0;
+            for (int xofs = 0; xofs < font->width; xofs++) {
+                if (c->rows[yofs * ymult + xofs / 8] & (1u << (xofs % 8))) {
+                    mask |= 1u << xofs;
+                }
+            }
+            glyph_masks[chr * font->height + yofs] = mask;
+        }
+    }
 }
 
 
@@ -67,23 +92,31 @@ void font_putchar(uint32_t *output, int owidth, int oheight, size_t ostride,
     if (chr >= ARRAY_SIZE(char_indices)) {
         return;
     }
-    const struct NPFChar *c = get_char(char_indices[chr]);
 
     if (x + font->width > owidth || y + font->height > oheight) {
         return;
     }
 
-    int ymult = DIV_ROUND_UP(font->width, 8);
+    const uint32_t *masks = glyph_masks + chr * font->height;
+    uint32_t *orow = (uint32_t *)((char *)output + y * ostride) + x;
+
     for (int yofs = 0; yofs < font->height; yofs++) {
-        for (int xofs = 0; xofs < font->width; xofs++) {
-            if (!(c->rows[yofs * ymult + xofs / 8] & (1u << (xofs % 8)))) {
-                continue;
+        // One run of set pixels at a time; adding the lowest set bit
+        // carries through (and so clears) the lowest run
+        uint32_t mask = masks[yofs];
+        while (mask) {
+            uint32_t rest = mask & (mask + (mask & -mask));
+            int start = __builtin_ctz(mask);
+            int len = __builtin_popcount(mask ^ rest);
+
+            for (uint32_t *optr = orow + start; len--; optr++) {
+                *optr = text_color;
             }
 
-            uint32_t *optr = (uint32_t *)((char *)output + (y + yofs) * ostride)
-                                 + x + xofs;
-            *optr = text_color;
+            mask = rest;
         }
+
+        orow = (uint32_t *)((char *)orow + ostride);
     }
 }
 
@@ -112,21 +145,26 @@ static uint32_t utf8_codepoint(const char **s)
             return REPLACEMENT_CHARACTER;
         }
         chr = (chr << 6) | (*((*s)++) & 0x3f);
+        mblen--;
     }
 
     return chr;
 }
 
 
-static const char *next_bsp(const char *text, int width)
+// Returns the space at which to break the line starting at @s, or NULL
+// if it does not need to be broken.  Only looks as far as the line
+// reaches, so every character is decoded about twice in total.
+static const char *next_bsp(const char *s, int width)
 {
     const char *last_space = NULL;
 
-    while (width > 0 && *text) {
-        const char *pre_cp = text;
-        uint32_t cp = utf8_codepoint(&text);
+    while (width > 0 && *s) {
+        const char *cp_start = s;
+        uint32_t cp = utf8_codepoint(&s);
+
         if (isspace(cp)) {
-            last_space = pre_cp;
+            last_space = cp_start;
         }
         if (cp >= 32) {
             width -= font->width + 1;
@@ -137,28 +175,33 @@ static const char *next_bsp(const char *text, int width)
 }
 
 
-void font_draw_text(uint32_t *output, int owidth, int oheight, size_t ostride,
-                    int x, int y, const char *text, uint32_t text_color)
+// Lays out @text like font_draw_text(), but only draws it if @output
+// is not NULL.  Returns the y coordinate below the last line.
+static int layout_text(uint32_t *output, int owidth, int oheight,
+                       size_t ostride, int x, int y, const char *text,
+                       uint32_t text_color)
 {
-    assert(x < owidth && y < oheight);
-
     int sx = x;
     const char *next_break = next_bsp(text, owidth - x);
 
     while (*text) {
-        const char *pre_chr = text;
+        const char *cp_start = text;
         uint32_t chr = utf8_codepoint(&text);
 
-        if (pre_chr == next_break) {
+        if (cp_start == next_break) {
             chr = '\n';
             next_break = next_bsp(text, owidth - sx);
         }
 
         if (chr >= 32) {
-            font_putchar(output, owidth, oheight, ostride, x, y, chr, text_color);
+            if (output) {
+                font_putchar(output, owidth, oheight, ostride, x, y, chr,
+                             text_color);
+            }
 
             x += font->width + 1;
-            if (*text != '\n' && next_break != text && x + font->width > owidth)
+            if (*text != '\n' && next_break != text &&
+                x + font->width > owidth)
             {
                 x = sx;
                 y += font->height + 1;
@@ -168,4 +211,21 @@ void font_draw_text(uint32_t *output, int owidth, int oheight, size_t ostride,
             y += font->height + 1;
         }
     }
+
+    return y + font->height;
+}
+
+
+void font_draw_text(uint32_t *output, int owidth, int oheight, size_t ostride,
+                    int x, int y, const char *text, uint32_t text_color)
+{
+    assert(x < owidth && y < oheight);
+
+    layout_text(output, owidth, oheight, ostride, x, y, text, text_color);
+}
+
+
+int font_text_height(const char *text, int width)
+{
+    return layout_text(NULL, width, INT_MAX, 0, 0, 0, text, 0);
 }
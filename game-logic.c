@@ -1,5 +1,8 @@
 #include <assert.h>
+#include <blit.h>
 #include <cards.h>
+#include <damage.h>
+#include <draw-list.h>
 #include <font.h>
 #include <game-logic.h>
 #include <image.h>
@@ -8,11 +11,14 @@
 #include <nonstddef.h>
 #include <ogg-vorbis.h>
 #include <platform.h>
+#include <region-grid.h>
 #include <regions.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <text-cache.h>
+#include <ui.h>
 
 
 const char *const party_name[PARTY_COUNT] = {
@@ -47,19 +53,40 @@ typedef enum MainPhase {
 } MainPhase;
 
 
-#define STATUS_X 1320
-#define STATUS_PHASE_Y   10
-#define STATUS_PHASE_H   40
-#define STATUS_TODO_Y    60
-#define STATUS_TODO_H    60
-#define STATUS_INFO_Y   120
-#define STATUS_INFO_H    40
-#define STATUS_PROMPT_Y 160
-#define STATUS_PROMPT_H  20
-#define STATUS_HAND_Y   180
-#define STATUS_HAND_H   460
-#define STATUS_ERROR_Y  800
-#define STATUS_ERROR_H   80
+// The assets are drawn for this size; everything is scaled from it to
+// the actual display size once when loading
+#define ASSET_W 1600
+#define ASSET_H  900
+
+#define SCALE_X(x) ((x) * fbw / ASSET_W)
+#define SCALE_Y(y) ((y) * fbh / ASSET_H)
+
+#define STATUS_X        SCALE_X(1320)
+#define STATUS_PHASE_Y  SCALE_Y(  10)
+#define STATUS_PHASE_H  SCALE_Y(  40)
+#define STATUS_TODO_Y   SCALE_Y(  60)
+#define STATUS_TODO_H   SCALE_Y(  60)
+#define STATUS_INFO_Y   SCALE_Y( 120)
+#define STATUS_INFO_H   SCALE_Y(  40)
+#define STATUS_PROMPT_Y SCALE_Y( 160)
+#define STATUS_PROMPT_H SCALE_Y(  20)
+#define STATUS_HAND_Y   SCALE_Y( 180)
+#define STATUS_HAND_H   SCALE_Y( 460)
+#define STATUS_ERROR_Y  SCALE_Y( 800)
+#define STATUS_ERROR_H  SCALE_Y(  80)
+
+// Layout of a card in the hand
+#define CARD_H          SCALE_Y(40)
+#define CARD_DESIGN_X   SCALE_X(16)
+#define CARD_DESIGN_Y   SCALE_Y(4)
+#define CARD_NAME_X     SCALE_X(56)
+#define CARD_NAME_Y     SCALE_Y(14)
+#define CARD_MARGIN_X   SCALE_X(16)
+#define HAND_PLAYER_Y   SCALE_Y(20)
+#define HAND_OPPONENT_Y SCALE_Y(30)
+
+#define DICE_SPACING_X  SCALE_X(16)
+#define DICE_SPACING_Y  SCALE_Y(16)
 
 
 typedef struct LoadedImage {
@@ -84,10 +111,43 @@ static size_t fb_stride;
 static uint8_t *region_areas;
 
 static uint32_t *bg_image;
+
+// bg_image plus every region's army counter, so the map only has to be
+// re-rendered where a counter changed; the markers are drawn on top of
+// this when compositing.  map_layer_army is what the counter of each
+// region in map_layer currently shows.
+static uint32_t *map_layer;
+static struct {
+    Party taken_by;
+    int troops;
+} map_layer_army[REGION_COUNT];
 static uint32_t *defeat_img, *victory_img;
 
+// Collects what changed on screen while handling a frame; the map is
+// recorded into it and everything is drawn at the end of handle_game()
+static DrawList frame_draw;
+
+// Army counters are composited from a per-party base token and the
+// digit atlas when a count first appears on the map (see army_counter()),
+// and then kept in army_img.  The base tokens are all tinted from the
+// same neutral (white) token with party_tint.  The atlas has one row of
+// full-size digits for counts below 10 and one of condensed digits for
+// two-digit counts, each ten cells wide and as high as the base tokens.
 static int army_img_w, army_img_h;
-static uint32_t *army_img[PARTY_COUNT][100];
+static SpanImage army_img[PARTY_COUNT][100];
+static uint32_t *army_base_img[PARTY_COUNT];
+static int army_base_w, army_base_h;
+static uint32_t *army_digits_img;
+static int army_digits_w, army_digits_h;
+static int army_digit_w[2][10];
+
+static const ColorMatrix party_tint[PARTY_COUNT] = {
+    [RED] = COLOR_MATRIX_TINT(0xc0, 0x00, 0x00),
+    [BLUE] = COLOR_MATRIX_TINT(0x00, 0x60, 0xe0),
+#ifdef HAVE_NEUTRAL
+    [GRAY] = COLOR_MATRIX_TINT(0xa0, 0xa0, 0xa0),
+#endif
+};
 
 static RegionID ai_focused_region, focused_region;
 static RegionID attacking_region, defending_region;
@@ -95,16 +155,27 @@ static RegionID origin_region, destination_region;
 static int attacking_count, defending_count;
 static bool ai_waiting_for_defending_count;
 
-static LoadedImage region_focus_img, attacking_region_img, attacked_region_img;
-static LoadedImage origin_region_img, destination_region_img, error_icon;
+static SpanImage region_focus_img, attacking_region_img, attacked_region_img;
+static SpanImage origin_region_img, destination_region_img;
+static LoadedImage error_icon;
 static int region_troops_max_w, region_troops_max_h;
 
-static int headings_w, headings_h = STATUS_PHASE_H;
-static uint32_t *game_phase_headings[GAME_PHASE_COUNT];
-static uint32_t *main_phase_headings[MAIN_PHASE_COUNT];
+static int headings_w, headings_h;
+static IndexedImage game_phase_headings[GAME_PHASE_COUNT];
+static IndexedImage main_phase_headings[MAIN_PHASE_COUNT];
 
 static int dice_w, dice_h;
-static uint32_t *dice_img[6];
+static SpanImage dice_img[6];
+
+// The status column
+static WidgetTree status_ui;
+static Widget heading_widget, todo_widget, info_widget, prompt_widget;
+static Widget hand_widget, dice_widget, message_widget;
+
+// What dice_widget shows: The attacker's dice in [0], the defender's
+// in [1]
+static int shown_dice[2][3];
+static int shown_dice_count[2];
 
 static GamePhase game_phase = INITIALIZATION;
 static MainPhase main_phase[PARTY_COUNT];
@@ -181,8 +252,10 @@ static int focused_card = -1;
 static uint64_t ai_select_trade_in_timestamp = 0;
 static uint64_t ai_do_trade_in_timestamp = (uint64_t)-1;
 
-static uint32_t *card_design_img[CARD_DESIGN_COUNT + 1]; // 32x32
-static uint32_t *card_bg_img, *card_hover_img, *card_selected_img; // 280x40
+static IndexedImage card_design_img[CARD_DESIGN_COUNT + 1];
+static int card_design_w, card_design_h;
+// (fbw - STATUS_X) x CARD_H
+static IndexedImage card_bg_img, card_hover_img, card_selected_img;
 
 _Static_assert(CARD_WILDCARD == CARD_DESIGN_COUNT,
                "CARD_WILDCARD should be at index CARD_DESIGN_COUNT");
@@ -213,18 +286,192 @@ static void __attribute__((format(printf, 1, 6)))
     vsnprintf(fname, sizeof(fname), fname_format, ap);
     va_end(ap);
 
-    if (!load_image(fname, d, w, h, s)) {
+    if (!load_scaled_image(fname, d, w, h, s, SCALE_BILINEAR)) {
         printf("Failed to load %s\n", fname);
         abort();
     }
 }
 
+static void __attribute__((format(printf, 1, 5)))
+    load_span_img(const char *fname_format, SpanImage *d, int *w, int *h, ...)
+{
+    va_list ap;
+    char fname[256];
+
+    va_start(ap, h);
+    vsnprintf(fname, sizeof(fname), fname_format, ap);
+    va_end(ap);
+
+    if (!load_span_image(fname, d, w, h)) {
+        printf("Failed to load %s\n", fname);
+        abort();
+    }
+}
+
+
+static void __attribute__((format(printf, 1, 5)))
+    load_indexed_img(const char *fname_format, IndexedImage *d, int *w, int *h,
+                     ...)
+{
+    va_list ap;
+    char fname[256];
+
+    va_start(ap, h);
+    vsnprintf(fname, sizeof(fname), fname_format, ap);
+    va_end(ap);
+
+    if (!load_indexed_image(fname, d, w, h)) {
+        printf("Failed to load %s\n", fname);
+        abort();
+    }
+}
+
+
+// Like load_img(), but does not scale the image
+static void __attribute__((format(printf, 1, 5)))
+    load_native_img(const char *fname_format, uint32_t **d, int *w, int *h,
+                    ...)
+{
+    va_list ap;
+    char fname[256];
+
+    va_start(ap, h);
+    vsnprintf(fname, sizeof(fname), fname_format, ap);
+    va_end(ap);
+
+    if (!load_image(fname, d, w, h, 0)) {
+        printf("Failed to load %s\n", fname);
+        abort();
+    }
+}
+
+
+static void init_army_digits(void)
+{
+    load_native_img("/army-digits.png", &army_digits_img,
+                    &army_digits_w, &army_digits_h);
+
+    int cell_w = army_digits_w / 10;
+    assert(army_digits_h == army_base_h * 2 && cell_w * 10 == army_digits_w);
+
+    // Each glyph is left-aligned in its cell; its width is up to the
+    // last column that is not fully transparent
+    for (int row = 0; row < 2; row++) {
+        for (int d = 0; d < 10; d++) {
+            for (int y = row * army_base_h; y < (row + 1) * army_base_h; y++) {
+                const uint32_t *line =
+                    army_digits_img + y * army_digits_w + d * cell_w;
+                for (int x = army_digit_w[row][d]; x < cell_w; x++) {
+                    if (line[x] >> 24) {
+                        army_digit_w[row][d] = x + 1;
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+// Blends digit @d from row @row of the digit atlas onto @counter (a base
+// token) at @x, keeping the token's alpha
+static void draw_army_digit(uint32_t *counter, int row, int d, int x)
+{
+    const uint32_t *glyph = army_digits_img + row * army_base_h * army_digits_w
+                          + d * (army_digits_w / 10);
+
+    for (int y = 0; y < army_base_h; y++) {
+        for (int i = 0; i < army_digit_w[row][d]; i++) {
+            uint32_t g = glyph[y * army_digits_w + i];
+            uint32_t a = g >> 24;
+            uint32_t *dp = &counter[y * army_base_w + x + i];
+
+            if (!a) {
+                continue;
+            }
+
+            uint32_t px = *dp & 0xff000000;
+            for (int c = 0; c < 24; c += 8) {
+                uint32_t v = (*dp >> c) & 0xff;
+                v = (v * (255 - a) + ((g >> c) & 0xff) * a + 127) / 255;
+                px |= v << c;
+            }
+            *dp = px;
+        }
+    }
+}
+
+
+static const SpanImage *army_counter(Party p, int troops)
+{
+    troops = MIN(troops, 99);
+
+    SpanImage *img = &army_img[p][troops];
+    if (img->rows) {
+        return img;
+    }
+
+    size_t size = army_base_w * army_base_h * sizeof(uint32_t);
+    uint32_t *counter = malloc(size);
+    if (!counter) {
+        printf("Failed to allocate army counter %i\n", troops);
+        abort();
+    }
+    memcpy(counter, army_base_img[p], size);
+
+    int digits[2], digit_count = 0;
+    if (troops >= 10) {
+        digits[digit_count++] = troops / 10;
+    }
+    digits[digit_count++] = troops % 10;
+
+    int row = digit_count - 1;
+    int text_w = 0;
+    for (int i = 0; i < digit_count; i++) {
+        text_w += army_digit_w[row][digits[i]];
+    }
+
+    int x = (army_base_w - text_w) / 2;
+    for (int i = 0; i < digit_count; i++) {
+        draw_army_digit(counter, row, digits[i], x);
+        x += army_digit_w[row][digits[i]];
+    }
+
+    if (army_img_w != army_base_w || army_img_h != army_base_h) {
+        // Same filter load_span_image() uses for all other sprites
+        uint32_t *scaled = malloc(army_img_w * army_img_h * sizeof(uint32_t));
+        if (!scaled) {
+            printf("Failed to allocate scaled army counter %i\n", troops);
+            abort();
+        }
+        scale_image(counter, army_base_w, army_base_h,
+                    army_base_w * sizeof(uint32_t), scaled,
+                    army_img_w, army_img_h, army_img_w * sizeof(uint32_t),
+                    SCALE_NEAREST);
+        free(counter);
+        counter = scaled;
+    }
+
+    if (!span_encode_image(counter, army_img_w, army_img_h, img)) {
+        printf("Failed to encode army counter %i\n", troops);
+        abort();
+    }
+    free(counter);
+
+    return img;
+}
+
+
+static void render_map_layer(int xmin, int ymin, int xmax, int ymax);
+static void init_status_ui(void);
 
 void init_game(void)
 {
     init_region_list();
 
-    fb = platform_funcs.framebuffer();
+    // Render into a back buffer if possible, so we do not have to wait
+    // for the host to finish reading the previous frame
+    fb = platform_funcs.fb_back_buffer ? platform_funcs.fb_back_buffer()
+                                       : platform_funcs.framebuffer();
     fbw = platform_funcs.fb_width();
     fbh = platform_funcs.fb_height();
     fb_stride = platform_funcs.fb_stride();
@@ -237,10 +484,25 @@ void init_game(void)
 
     platform_funcs.limit_pointing_device(fbw, fbh);
 
+    // Scale all assets to the display once here, so drawing them later
+    // costs the same as at the native size
+    image_set_scale(fbw, ASSET_W, fbh, ASSET_H);
+
+    for (RegionID i = 1; i < REGION_COUNT; i++) {
+        regions[i].troops_pos.x = SCALE_X(regions[i].troops_pos.x);
+        regions[i].troops_pos.y = SCALE_Y(regions[i].troops_pos.y);
+    }
+
     load_img("/bg.png", &bg_image, &fbw, &fbh, fb_stride);
 
+    // Must not be interpolated, the colors are region IDs
     uint32_t *region_areas_img = NULL;
-    load_img("/region-areas.png", &region_areas_img, &fbw, &fbh, 0);
+    if (!load_scaled_image("/region-areas.png", &region_areas_img,
+                           &fbw, &fbh, 0, SCALE_NEAREST))
+    {
+        puts("Failed to load /region-areas.png");
+        abort();
+    }
 
     region_areas = malloc(fbw * fbh);
     uint32_t *region_areas_img_ptr = region_areas_img;
@@ -269,82 +531,111 @@ void init_game(void)
 
     load_img("/error-icon.png", &error_icon.d, &error_icon.w, &error_icon.h, 0);
 
-    load_img("/army-none.png", &army_img[0][0], &army_img_w, &army_img_h, 0);
+    load_span_img("/army-none.png", &army_img[0][0], &army_img_w, &army_img_h);
     for (Party p = 1; p < PARTY_COUNT; p++) {
         army_img[p][0] = army_img[0][0];
     }
 
-    for (int i = 1; i < 100; i++) {
-        for (Party p = 0; p < PARTY_COUNT; p++) {
-            load_img("/army-%s-%i.png", &army_img[p][i], &army_img_w,
-                     &army_img_h, 0, party_name[p], i);
+    // Composited at the native size, scaled afterwards
+    uint32_t *army_token_img = NULL;
+    load_native_img("/army-token.png", &army_token_img,
+                    &army_base_w, &army_base_h);
+
+    size_t army_base_size = army_base_w * army_base_h * sizeof(uint32_t);
+    for (Party p = 0; p < PARTY_COUNT; p++) {
+        army_base_img[p] = malloc(army_base_size);
+        if (!army_base_img[p]) {
+            printf("Failed to allocate army token for party %i\n", (int)p);
+            abort();
         }
+        memcpy(army_base_img[p], army_token_img, army_base_size);
+        tint_image(army_base_img[p], army_base_w, army_base_h,
+                   army_base_w * sizeof(uint32_t), &party_tint[p]);
     }
+    free(army_token_img);
+
+    init_army_digits();
 
-    load_img("/focus-region.png", &region_focus_img.d, &region_focus_img.w,
-             &region_focus_img.h, 0);
+    load_span_img("/focus-region.png", &region_focus_img, &region_focus_img.w,
+                  &region_focus_img.h);
     region_troops_max_w = MAX(region_troops_max_w, region_focus_img.w);
     region_troops_max_h = MAX(region_troops_max_h, region_focus_img.h);
 
-    load_img("/attacking-region.png", &attacking_region_img.d,
-             &attacking_region_img.w, &attacking_region_img.h, 0);
+    load_span_img("/attacking-region.png", &attacking_region_img,
+                  &attacking_region_img.w, &attacking_region_img.h);
     region_troops_max_w = MAX(region_troops_max_w, attacking_region_img.w);
     region_troops_max_h = MAX(region_troops_max_h, attacking_region_img.h);
 
-    load_img("/attacked-region.png", &attacked_region_img.d,
-             &attacked_region_img.w, &attacked_region_img.h, 0);
+    load_span_img("/attacked-region.png", &attacked_region_img,
+                  &attacked_region_img.w, &attacked_region_img.h);
     region_troops_max_w = MAX(region_troops_max_w, attacked_region_img.w);
     region_troops_max_h = MAX(region_troops_max_h, attacked_region_img.h);
 
-    load_img("/origin-region.png", &origin_region_img.d, &origin_region_img.w,
-             &origin_region_img.h, 0);
+    load_span_img("/origin-region.png", &origin_region_img,
+                  &origin_region_img.w, &origin_region_img.h);
     region_troops_max_w = MAX(region_troops_max_w, origin_region_img.w);
     region_troops_max_h = MAX(region_troops_max_h, origin_region_img.h);
 
-    load_img("/destination-region.png", &destination_region_img.d,
-             &destination_region_img.w, &destination_region_img.h, 0);
+    load_span_img("/destination-region.png", &destination_region_img,
+                  &destination_region_img.w, &destination_region_img.h);
     region_troops_max_w = MAX(region_troops_max_w, destination_region_img.w);
     region_troops_max_h = MAX(region_troops_max_h, destination_region_img.h);
 
     for (int i = 0; i < 6; i++) {
-        load_img("/die-%i.png", &dice_img[i], &dice_w, &dice_h, 0, i + 1);
+        load_span_img("/die-%i.png", &dice_img[i], &dice_w, &dice_h, i + 1);
+    }
+
+    region_grid_init(fbw, fbh, MAX(army_img_w, region_troops_max_w),
+                     MAX(army_img_h, region_troops_max_h));
+
+    map_layer = malloc(fbh * fb_stride);
+    for (RegionID i = 1; i < REGION_COUNT; i++) {
+        map_layer_army[i].taken_by = regions[i].taken_by;
+        map_layer_army[i].troops = MIN(regions[i].troops, 99);
     }
+    render_map_layer(0, 0, STATUS_X, fbh);
+    draw_list_init(&frame_draw, fbw, fbh);
 
     load_img("/defeat.png", &defeat_img, &fbw, &fbh, 0);
     load_img("/victory.png", &victory_img, &fbw, &fbh, 0);
 
     headings_w = fbw - STATUS_X;
-    load_img("/preparation.png", &game_phase_headings[PREPARATION],
-             &headings_w, &headings_h, 0);
-    load_img("/game-over.png", &game_phase_headings[GAME_OVER],
-             &headings_w, &headings_h, 0);
-    load_img("/waiting-for-other.png",
-             &main_phase_headings[MAIN_WAITING_FOR_OTHER],
-             &headings_w, &headings_h, 0);
-    load_img("/reinforcements.png", &main_phase_headings[MAIN_REINFORCEMENT],
-             &headings_w, &headings_h, 0);
-    load_img("/trade-in.png", &main_phase_headings[MAIN_TRADE_IN_CARDS],
-             &headings_w, &headings_h, 0);
-    load_img("/battle.png", &main_phase_headings[MAIN_BATTLE],
-             &headings_w, &headings_h, 0);
-    load_img("/movement.png", &main_phase_headings[MAIN_MOVEMENT],
-             &headings_w, &headings_h, 0);
+    headings_h = STATUS_PHASE_H;
+    load_indexed_img("/preparation.png", &game_phase_headings[PREPARATION],
+                     &headings_w, &headings_h);
+    load_indexed_img("/game-over.png", &game_phase_headings[GAME_OVER],
+                     &headings_w, &headings_h);
+    load_indexed_img("/waiting-for-other.png",
+                     &main_phase_headings[MAIN_WAITING_FOR_OTHER],
+                     &headings_w, &headings_h);
+    load_indexed_img("/reinforcements.png",
+                     &main_phase_headings[MAIN_REINFORCEMENT],
+                     &headings_w, &headings_h);
+    load_indexed_img("/trade-in.png",
+                     &main_phase_headings[MAIN_TRADE_IN_CARDS],
+                     &headings_w, &headings_h);
+    load_indexed_img("/battle.png", &main_phase_headings[MAIN_BATTLE],
+                     &headings_w, &headings_h);
+    load_indexed_img("/movement.png", &main_phase_headings[MAIN_MOVEMENT],
+                     &headings_w, &headings_h);
 
     main_phase_headings[MAIN_BATTLE_TRADE_IN_CARDS] =
         main_phase_headings[MAIN_TRADE_IN_CARDS];
 
     for (CardDesign d = 0; d <= CARD_WILDCARD; d++) {
-        int card_design_w = 32, card_design_h = 32;
-        load_img("/card-design-%i.png", &card_design_img[d], &card_design_w,
-                 &card_design_h, 0, d);
+        load_indexed_img("/card-design-%i.png", &card_design_img[d],
+                         &card_design_w, &card_design_h, d);
     }
 
-    int card_marker_w = fbw - STATUS_X, card_marker_h = 40;
-    load_img("/card-bg.png", &card_bg_img, &card_marker_w, &card_marker_h, 0);
-    load_img("/card-hover.png", &card_hover_img,
-             &card_marker_w, &card_marker_h, 0);
-    load_img("/card-selected.png", &card_selected_img,
-             &card_marker_w, &card_marker_h, 0);
+    int card_marker_w = fbw - STATUS_X, card_marker_h = CARD_H;
+    load_indexed_img("/card-bg.png", &card_bg_img,
+                     &card_marker_w, &card_marker_h);
+    load_indexed_img("/card-hover.png", &card_hover_img,
+                     &card_marker_w, &card_marker_h);
+    load_indexed_img("/card-selected.png", &card_selected_img,
+                     &card_marker_w, &card_marker_h);
+
+    init_status_ui();
 
     load_sfx("/battle.ogg", &battle_snd);
     load_sfx("/beep1.ogg", &beep1_snd);
@@ -357,7 +648,9 @@ void init_game(void)
 }
 
 
-static void clear_to_bg(int x, int y, int w, int h)
+// Copies the given area from @src to @dst (both framebuffer-sized)
+static void copy_area(uint32_t *dst, const uint32_t *src,
+                      int x, int y, int w, int h)
 {
     if (x >= fbw || y >= fbh) {
         return;
@@ -378,129 +671,108 @@ static void clear_to_bg(int x, int y, int w, int h)
     }
 
     for (int yofs = 0; yofs < h; yofs++) {
-        memcpy((char *)(fb + x) + (y + yofs) * fb_stride,
-               (char *)(bg_image + x) + (y + yofs) * fb_stride,
+        memcpy((char *)(dst + x) + (y + yofs) * fb_stride,
+               (const char *)(src + x) + (y + yofs) * fb_stride,
                w * sizeof(uint32_t));
     }
 }
 
 
-static void ablitlmt(uint32_t *dst, uint32_t *src, int dx, int dy,
-                     int sw, int sh, size_t dstride, size_t sstride,
-                     int xmin, int ymin, int xmax, int ymax)
+// Redraws the given area of the map layer
+static void render_map_layer(int xmin, int ymin, int xmax, int ymax)
 {
-    int sx_start = MAX(xmin - dx, 0);
-    int sx_end = MIN(xmax - dx, sw);
+    copy_area(map_layer, bg_image, xmin, ymin, xmax - xmin, ymax - ymin);
 
-    int sy_start = MAX(ymin - dy, 0);
-    int sy_end = MIN(ymax - dy, sh);
+    RegionID visible[REGION_COUNT];
+    int count = region_grid_query(xmin, ymin, xmax, ymax, visible);
+
+    for (int j = 0; j < count; j++) {
+        RegionID i = visible[j];
+        sblitlmt(map_layer,
+                 army_counter(regions[i].taken_by, regions[i].troops),
+                 regions[i].troops_pos.x - army_img_w / 2,
+                 regions[i].troops_pos.y - army_img_h / 2,
+                 fb_stride, xmin, ymin, xmax, ymax);
+    }
+}
 
-    for (int sy = sy_start; sy < sy_end; sy++) {
-        for (int sx = sx_start; sx < sx_end; sx++) {
-            uint32_t s, *d, a, rb, g;
 
-            s = ((uint32_t *)((char *)src + sy * sstride))[sx];
-            d = &((uint32_t *)((char *)dst + (dy + sy) * dstride))[dx + sx];
+// Re-renders the counters of all regions whose owner or troop count
+// has changed since they were last drawn into the map layer
+static void update_map_layer(void)
+{
+    for (RegionID i = 1; i < REGION_COUNT; i++) {
+        int troops = MIN(regions[i].troops, 99);
 
-            // Spread a to 0..256 so we can lsr 8 instead of div 0xff
-            a = (s >> 24) + (s >> 31);
-            rb = *d & 0xff00ff;
-            g = *d & 0x00ff00;
-            rb = ((((s & 0xff00ff) - rb) * a) + (rb << 8)) >> 8;
-            g = ((((s & 0x00ff00) - g) * a) + (g << 8)) >> 8;
-            *d = (rb & 0xff00ff) | (g & 0x00ff00) | 0xff000000;
+        if (map_layer_army[i].taken_by == regions[i].taken_by &&
+            map_layer_army[i].troops == troops)
+        {
+            continue;
         }
+
+        map_layer_army[i].taken_by = regions[i].taken_by;
+        map_layer_army[i].troops = troops;
+
+        int x = regions[i].troops_pos.x - army_img_w / 2;
+        int y = regions[i].troops_pos.y - army_img_h / 2;
+        render_map_layer(MAX(x, 0), MAX(y, 0),
+                         MIN(x + army_img_w, fbw), MIN(y + army_img_h, fbh));
     }
 }
 
 
-static void refresh(int xmin, int ymin, int xmax, int ymax)
-{
-    xmax = MIN(xmax, STATUS_X);
-    if (xmin >= STATUS_X) {
-        return;
-    }
+// The status column is taken care of by ui_render()
+#define REFRESH_INCLUDE(xmin, ymin, xmax, ymax) \
+    draw_damage(&frame_draw, xmin, ymin, MIN(xmax, STATUS_X), ymax)
 
-    clear_to_bg(xmin, ymin, xmax - xmin, ymax - ymin);
+#define REFRESH_INCLUDE_REGION_TROOPS(r) \
+    do { \
+        int hcfw = region_troops_max_w / 2; \
+        int hcfh = region_troops_max_h / 2; \
+        int tpx = regions[(r)].troops_pos.x; \
+        int tpy = regions[(r)].troops_pos.y; \
+        REFRESH_INCLUDE(tpx - hcfw, tpy - hcfh, tpx + hcfw, tpy + hcfh); \
+    } while (0)
 
-    for (RegionID i = 1; i < REGION_COUNT; i++) {
-        ablitlmt(fb, army_img[regions[i].taken_by][MIN(regions[i].troops, 99)],
-                 regions[i].troops_pos.x - army_img_w / 2,
-                 regions[i].troops_pos.y - army_img_h / 2,
-                 army_img_w, army_img_h, fb_stride,
-                 army_img_w * sizeof(uint32_t),
-                 xmin, ymin, xmax, ymax);
 
-        if (i == attacking_region) {
-            ablitlmt(fb, attacking_region_img.d,
-                     regions[i].troops_pos.x - attacking_region_img.w / 2,
-                     regions[i].troops_pos.y - attacking_region_img.h / 2,
-                     attacking_region_img.w, attacking_region_img.h,
-                     fb_stride, attacking_region_img.w * sizeof(uint32_t),
-                     xmin, ymin, xmax, ymax);
-        }
+static void record_marker(DrawList *dl, const SpanImage *img,
+                          RegionID region)
+{
+    if (region == NULL_REGION) {
+        return;
+    }
 
-        if (i == defending_region) {
-            ablitlmt(fb, attacked_region_img.d,
-                     regions[i].troops_pos.x - attacked_region_img.w / 2,
-                     regions[i].troops_pos.y - attacked_region_img.h / 2,
-                     attacked_region_img.w, attacked_region_img.h,
-                     fb_stride, attacked_region_img.w * sizeof(uint32_t),
-                     xmin, ymin, xmax, ymax);
-        }
+    draw_span(dl, 1, img,
+              regions[region].troops_pos.x - img->w / 2,
+              regions[region].troops_pos.y - img->h / 2);
+}
 
-        if (i == origin_region) {
-            ablitlmt(fb, origin_region_img.d,
-                     regions[i].troops_pos.x - origin_region_img.w / 2,
-                     regions[i].troops_pos.y - origin_region_img.h / 2,
-                     origin_region_img.w, origin_region_img.h,
-                     fb_stride, origin_region_img.w * sizeof(uint32_t),
-                     xmin, ymin, xmax, ymax);
-        }
 
-        if (i == destination_region) {
-            ablitlmt(fb, destination_region_img.d,
-                     regions[i].troops_pos.x - destination_region_img.w / 2,
-                     regions[i].troops_pos.y - destination_region_img.h / 2,
-                     destination_region_img.w, destination_region_img.h,
-                     fb_stride, destination_region_img.w * sizeof(uint32_t),
-                     xmin, ymin, xmax, ymax);
-        }
+// Records the map layer, the markers on top, and the game over overlay.
+// Which parts actually get redrawn is up to the damage in @dl.
+static void record_map(DrawList *dl)
+{
+    // May allocate, so the boot hart does this before executing the list
+    update_map_layer();
 
-        if (i == ai_focused_region) {
-            ablitlmt(fb, region_focus_img.d,
-                     regions[i].troops_pos.x - region_focus_img.w / 2,
-                     regions[i].troops_pos.y - region_focus_img.h / 2,
-                     region_focus_img.w, region_focus_img.h,
-                     fb_stride, region_focus_img.w * sizeof(uint32_t),
-                     xmin, ymin, xmax, ymax);
-        }
+    draw_set_clip(dl, 0, 0, STATUS_X, fbh);
+    draw_copy(dl, 0, map_layer, fb_stride);
 
-        if (i == focused_region) {
-            ablitlmt(fb, region_focus_img.d,
-                     regions[i].troops_pos.x - region_focus_img.w / 2,
-                     regions[i].troops_pos.y - region_focus_img.h / 2,
-                     region_focus_img.w, region_focus_img.h,
-                     fb_stride, region_focus_img.w * sizeof(uint32_t),
-                     xmin, ymin, xmax, ymax);
-        }
-    }
+    record_marker(dl, &attacking_region_img, attacking_region);
+    record_marker(dl, &attacked_region_img, defending_region);
+    record_marker(dl, &origin_region_img, origin_region);
+    record_marker(dl, &destination_region_img, destination_region);
+    record_marker(dl, &region_focus_img, ai_focused_region);
+    record_marker(dl, &region_focus_img, focused_region);
 
     if (game_phase == GAME_OVER) {
-        if (party_defeated[PLAYER]) {
-            ablitlmt(fb, defeat_img, 0, 0, fbw, fbh, fb_stride,
-                     fbw * sizeof(uint32_t), xmin, ymin, xmax, ymax);
-        } else {
-            ablitlmt(fb, victory_img, 0, 0, fbw, fbh, fb_stride,
-                     fbw * sizeof(uint32_t), xmin, ymin, xmax, ymax);
-        }
+        draw_blend(dl, 2, party_defeated[PLAYER] ? defeat_img : victory_img,
+                   fbw, fbh, 0, 0);
     }
-
-    platform_funcs.fb_flush(xmin, ymin, xmax - xmin, ymax - ymin);
 }
 
 
-static void refresh_hand(void)
+static void draw_hand(const Widget *w, uint32_t *dst, size_t stride)
 {
     Party p;
     for (p = 0; p < PARTY_COUNT; p++) {
@@ -509,88 +781,150 @@ static void refresh_hand(void)
         }
     }
 
-    clear_to_bg(STATUS_X, STATUS_HAND_Y, fbw - STATUS_X, STATUS_HAND_H);
-
     if (p == PARTY_COUNT) {
-        platform_funcs.fb_flush(STATUS_X, STATUS_HAND_Y, fbw - STATUS_X,
-                                STATUS_HAND_H);
         return;
     }
 
+    int xmax = w->x + w->w, ymax = w->y + w->h;
+
     if (p == PLAYER) {
-        font_draw_text(fb, fbw, fbh, fb_stride, STATUS_X, STATUS_HAND_Y,
-                       "Your cards:", 0);
+        text_cache_draw(dst, xmax, ymax, stride, w->x, w->y,
+                        "Your cards:", 0);
     }
 
     // Hoo boy FIXME
-    int card_offset = p == PLAYER ? 20 : 30;
+    int card_offset = p == PLAYER ? HAND_PLAYER_Y : HAND_OPPONENT_Y;
 
-    int y = STATUS_HAND_Y + card_offset;
+    int y = w->y + card_offset;
     for (int i = 0; i < party_hand_size(p); i++) {
         const Card *c = party_hand_card(p, i);
 
         // You can have a maximum of eleven cards in hand (I think),
         // so this should be enough
-        assert(y < STATUS_HAND_Y + STATUS_HAND_H);
+        assert(y < ymax);
 
         if (p == PLAYER || c->selected) {
-            int w = fbw - STATUS_X;
-            ablitlmt(fb, card_bg_img, STATUS_X, y, w, 40, fb_stride,
-                     w * sizeof(uint32_t), STATUS_X, y, fbw, y + 40);
+            iblitlmt(dst, &card_bg_img, w->x, y, stride,
+                     w->x, y, xmax, y + CARD_H);
         }
 
         if (c->selected) {
-            int w = fbw - STATUS_X;
-            ablitlmt(fb, card_selected_img, STATUS_X, y, w, 40, fb_stride,
-                     w * sizeof(uint32_t), STATUS_X, y, fbw, y + 40);
+            iblitlmt(dst, &card_selected_img, w->x, y, stride,
+                     w->x, y, xmax, y + CARD_H);
         }
 
         if (p == PLAYER && focused_card == i) {
-            int w = fbw - STATUS_X;
-            ablitlmt(fb, card_hover_img, STATUS_X, y, w, 40, fb_stride,
-                     w * sizeof(uint32_t), STATUS_X, y, fbw, y + 40);
+            iblitlmt(dst, &card_hover_img, w->x, y, stride,
+                     w->x, y, xmax, y + CARD_H);
         }
 
         if (p == PLAYER || c->selected) {
-            ablitlmt(fb, card_design_img[c->design], STATUS_X + 16, y + 4, 32, 32,
-                     fb_stride, 32 * sizeof(uint32_t), STATUS_X, y, fbw, y + 40);
+            iblitlmt(dst, &card_design_img[c->design],
+                     w->x + CARD_DESIGN_X, y + CARD_DESIGN_Y, stride,
+                     w->x, y, xmax, y + CARD_H);
 
-            font_draw_text(fb, fbw - 16, fbh, fb_stride, STATUS_X + 56, y + 14,
-                           c->design == CARD_WILDCARD ? "(Wildcard)"
-                                                      : regions[c->region].name,
-                           0);
+            const char *name = c->design == CARD_WILDCARD
+                             ? "(Wildcard)"
+                             : regions[c->region].name;
+            text_cache_draw(dst, xmax - CARD_MARGIN_X, ymax, stride,
+                            w->x + CARD_NAME_X, y + CARD_NAME_Y, name, 0);
 
-            y += 40;
+            y += CARD_H;
         }
     }
 
-    if (y > STATUS_HAND_Y + card_offset && p != PLAYER) {
-        font_draw_text(fb, fbw, fbh, fb_stride, STATUS_X, STATUS_HAND_Y,
-                       "Cards traded in by your opponent:", 0);
+    if (y > w->y + card_offset && p != PLAYER) {
+        text_cache_draw(dst, xmax, ymax, stride, w->x, w->y,
+                        "Cards traded in by your opponent:", 0);
     }
+}
 
-    platform_funcs.fb_flush(STATUS_X, STATUS_HAND_Y, fbw - STATUS_X,
-                            STATUS_HAND_H);
+
+static void draw_dice(const Widget *w, uint32_t *dst, size_t stride)
+{
+    int y = w->y;
+
+    for (int side = 0; side < 2; side++) {
+        for (int i = 0; i < shown_dice_count[side]; i++) {
+            int x = w->x + (dice_w + DICE_SPACING_X) * i;
+            sblitlmt(dst, &dice_img[shown_dice[side][i]], x, y, stride,
+                     w->x, w->y, w->x + w->w, w->y + w->h);
+        }
+        y += dice_h + DICE_SPACING_Y;
+    }
 }
 
 
-static void clear_invalid_move(void);
+static void init_status_ui(void)
+{
+    ui_init(&status_ui, STATUS_X, 0, fbw - STATUS_X, fbh, bg_image, fbw, fbh);
+
+    ui_add_widget(&status_ui, &heading_widget, WIDGET_IMAGE,
+                  STATUS_PHASE_Y, STATUS_PHASE_H);
+    ui_add_widget(&status_ui, &todo_widget, WIDGET_TEXT,
+                  STATUS_TODO_Y, STATUS_TODO_H);
+    ui_add_widget(&status_ui, &info_widget, WIDGET_TEXT,
+                  STATUS_INFO_Y, STATUS_INFO_H);
+    ui_add_widget(&status_ui, &prompt_widget, WIDGET_TEXT,
+                  STATUS_PROMPT_Y, STATUS_PROMPT_H);
+
+    ui_add_widget(&status_ui, &hand_widget, WIDGET_CUSTOM,
+                  STATUS_HAND_Y, STATUS_HAND_H);
+    hand_widget.draw = draw_hand;
+
+    // Two rows of dice right above the message; rounding while scaling
+    // may leave a pixel less than that, so the dice are clipped then
+    int dice_y = STATUS_ERROR_Y - (dice_h + DICE_SPACING_Y) * 2;
+    dice_y = MAX(dice_y, STATUS_HAND_Y + STATUS_HAND_H);
+    ui_add_widget(&status_ui, &dice_widget, WIDGET_CUSTOM,
+                  dice_y, STATUS_ERROR_Y - dice_y);
+    dice_widget.draw = draw_dice;
+
+    ui_add_widget(&status_ui, &message_widget, WIDGET_TEXT,
+                  STATUS_ERROR_Y, STATUS_ERROR_H);
+}
 
-static void important_message(const char *message, bool error)
+
+static void set_heading(const IndexedImage *heading)
 {
-    clear_invalid_move();
+    ui_set_image(&heading_widget, heading);
+}
 
-    puts(message);
 
-    ablitlmt(fb, error_icon.d, STATUS_X, STATUS_ERROR_Y, error_icon.w,
-             error_icon.h, fb_stride, error_icon.w * sizeof(uint32_t), 0, 0,
-             fbw, fbh);
+static void hide_dice(void)
+{
+    if (shown_dice_count[0] || shown_dice_count[1]) {
+        shown_dice_count[0] = shown_dice_count[1] = 0;
+        ui_invalidate(&dice_widget);
+    }
+}
+
+
+// Empties the whole status column, except for the hand (which is
+// always kept up to date through refresh_hand())
+static void clear_status(void)
+{
+    set_heading(NULL);
+    ui_set_text(&todo_widget, "", 0);
+    ui_set_text(&info_widget, "", 0);
+    ui_set_text(&prompt_widget, "", 0);
+    ui_set_text(&message_widget, "", 0);
+    hide_dice();
+}
+
+
+static void refresh_hand(void)
+{
+    ui_invalidate(&hand_widget);
+}
 
-    font_draw_text(fb, fbw, fbh, fb_stride, STATUS_X + error_icon.w + 10,
-                   STATUS_ERROR_Y, message, 0x400000);
 
-    platform_funcs.fb_flush(STATUS_X, STATUS_ERROR_Y,
-                            fbw - STATUS_X, fbh - STATUS_ERROR_Y);
+static void important_message(const char *message, bool error)
+{
+    puts(message);
+
+    ui_set_icon(&message_widget, error_icon.d, error_icon.w, error_icon.h);
+    ui_set_text(&message_widget, message, 0x400000);
 
     // We might want a different notification sound, depending on
     // whether it is a user error or just an in-game notification
@@ -608,9 +942,7 @@ static void invalid_move(const char *message)
 
 static void clear_invalid_move(void)
 {
-    clear_to_bg(STATUS_X, STATUS_ERROR_Y, fbw - STATUS_X, STATUS_ERROR_H);
-    platform_funcs.fb_flush(STATUS_X, STATUS_ERROR_Y, fbw - STATUS_X,
-                            STATUS_ERROR_H);
+    ui_set_text(&message_widget, "", 0);
 }
 
 
@@ -648,12 +980,8 @@ static void switch_main_phase(Party p, MainPhase new_phase)
     switch (new_phase) {
         case MAIN_WAITING_FOR_OTHER: {
             if (p == PLAYER) {
-                clear_to_bg(STATUS_X, 0, fbw - STATUS_X, fbh);
-                ablitlmt(fb, main_phase_headings[new_phase], STATUS_X,
-                         STATUS_PHASE_Y, headings_w, headings_h, fb_stride,
-                         headings_w * sizeof(uint32_t), STATUS_X, STATUS_PHASE_Y,
-                         fbw, STATUS_PHASE_Y + STATUS_PHASE_H);
-                platform_funcs.fb_flush(STATUS_X, 0, fbw - STATUS_X, fbh);
+                clear_status();
+                set_heading(&main_phase_headings[new_phase]);
             }
 
             if (game_phase == MAIN) {
@@ -686,20 +1014,16 @@ static void switch_main_phase(Party p, MainPhase new_phase)
                 return;
             }
             if (p == PLAYER) {
-                clear_to_bg(STATUS_X, 0, fbw - STATUS_X, fbh);
-                ablitlmt(fb, main_phase_headings[new_phase], STATUS_X,
-                         STATUS_PHASE_Y, headings_w, headings_h, fb_stride,
-                         headings_w * sizeof(uint32_t), STATUS_X, STATUS_PHASE_Y,
-                         fbw, STATUS_PHASE_Y + STATUS_PHASE_H);
-                font_draw_text(fb, fbw, fbh, fb_stride, STATUS_X, STATUS_TODO_Y,
-                               "Choose cards to trade in for extra armies.", 0);
+                clear_status();
+                set_heading(&main_phase_headings[new_phase]);
+                ui_set_text(&todo_widget,
+                            "Choose cards to trade in for extra armies.",
+                            0);
                 if (party_hand_size(p) < 5) {
-                    font_draw_text(fb, fbw, fbh, fb_stride, STATUS_X,
-                                   STATUS_INFO_Y,
-                                   "Press enter to confirm, or the space bar "
-                                   "to skip.", 0);
+                    ui_set_text(&info_widget,
+                                "Press enter to confirm, or the space bar "
+                                "to skip.", 0);
                 }
-                platform_funcs.fb_flush(STATUS_X, 0, fbw - STATUS_X, fbh);
             }
             break;
         }
@@ -733,33 +1057,23 @@ static void switch_main_phase(Party p, MainPhase new_phase)
                          troops_to_place[p],
                          troops_to_place[p] == 1 ? "army" : "armies");
 
-                clear_to_bg(STATUS_X, 0, fbw - STATUS_X, fbh);
-                ablitlmt(fb, main_phase_headings[new_phase], STATUS_X,
-                         STATUS_PHASE_Y, headings_w, headings_h, fb_stride,
-                         headings_w * sizeof(uint32_t), STATUS_X, STATUS_PHASE_Y,
-                         fbw, STATUS_PHASE_Y + STATUS_PHASE_H);
-                font_draw_text(fb, fbw, fbh, fb_stride, STATUS_X, STATUS_TODO_Y,
-                               "Reinforce your regions by placing troops.", 0);
-                font_draw_text(fb, fbw, fbh, fb_stride, STATUS_X, STATUS_INFO_Y,
-                               buf, 0);
-                platform_funcs.fb_flush(STATUS_X, 0, fbw - STATUS_X, fbh);
+                clear_status();
+                set_heading(&main_phase_headings[new_phase]);
+                ui_set_text(&todo_widget,
+                            "Reinforce your regions by placing troops.", 0);
+                ui_set_text(&info_widget, buf, 0);
             }
             break;
         }
 
         case MAIN_BATTLE: {
             if (p == PLAYER) {
-                clear_to_bg(STATUS_X, 0, fbw - STATUS_X, fbh);
-                ablitlmt(fb, main_phase_headings[new_phase], STATUS_X,
-                         STATUS_PHASE_Y, headings_w, headings_h, fb_stride,
-                         headings_w * sizeof(uint32_t), STATUS_X, STATUS_PHASE_Y,
-                         fbw, STATUS_PHASE_Y + STATUS_PHASE_H);
-                font_draw_text(fb, fbw, fbh, fb_stride, STATUS_X, STATUS_TODO_Y,
-                               "Choose a region to attack from.", 0);
-                font_draw_text(fb, fbw, fbh, fb_stride, STATUS_X, STATUS_INFO_Y,
-                               "Press the space bar to end the battle phase.",
-                               0);
-                platform_funcs.fb_flush(STATUS_X, 0, fbw - STATUS_X, fbh);
+                clear_status();
+                set_heading(&main_phase_headings[new_phase]);
+                ui_set_text(&todo_widget, "Choose a region to attack from.", 0);
+                ui_set_text(&info_widget,
+                            "Press the space bar to end the battle phase.",
+                            0);
             }
             break;
         }
@@ -771,16 +1085,11 @@ static void switch_main_phase(Party p, MainPhase new_phase)
                 draw_card_this_turn = false;
             }
             if (p == PLAYER) {
-                clear_to_bg(STATUS_X, 0, fbw - STATUS_X, fbh);
-                ablitlmt(fb, main_phase_headings[new_phase], STATUS_X,
-                         STATUS_PHASE_Y, headings_w, headings_h, fb_stride,
-                         headings_w * sizeof(uint32_t), STATUS_X, STATUS_PHASE_Y,
-                         fbw, STATUS_PHASE_Y + STATUS_PHASE_H);
-                font_draw_text(fb, fbw, fbh, fb_stride, STATUS_X, STATUS_TODO_Y,
-                               "Choose one region to move troops from.", 0);
-                font_draw_text(fb, fbw, fbh, fb_stride, STATUS_X, STATUS_INFO_Y,
-                               "Press the space bar to skip.", 0);
-                platform_funcs.fb_flush(STATUS_X, 0, fbw - STATUS_X, fbh);
+                clear_status();
+                set_heading(&main_phase_headings[new_phase]);
+                ui_set_text(&todo_widget,
+                            "Choose one region to move troops from.", 0);
+                ui_set_text(&info_widget, "Press the space bar to skip.", 0);
             }
             break;
         }
@@ -873,33 +1182,26 @@ static void switch_game_phase(GamePhase new_phase)
             }
 #endif
 
-            clear_to_bg(STATUS_X, 0, fbw - STATUS_X, fbh);
-
-            ablitlmt(fb, game_phase_headings[new_phase], STATUS_X,
-                     STATUS_PHASE_Y, headings_w, headings_h, fb_stride,
-                     headings_w * sizeof(uint32_t), STATUS_X, STATUS_PHASE_Y,
-                     fbw, STATUS_PHASE_Y + STATUS_PHASE_H);
+            clear_status();
+            set_heading(&game_phase_headings[new_phase]);
 
-            font_draw_text(fb, fbw, fbh, fb_stride, STATUS_X, STATUS_TODO_Y,
+            ui_set_text(&todo_widget,
 #ifdef HAVE_NEUTRAL
-                           "Reinforce your regions by placing two additional "
-                           "armies per turn.",
+                        "Reinforce your regions by placing two additional "
+                        "armies per turn.",
 #else
-                           "Claim regions by placing troops in them.",
+                        "Claim regions by placing troops in them.",
 #endif
-                           0);
+                        0);
 
 #ifdef HAVE_NEUTRAL
             char buf[64];
             snprintf(buf, sizeof(buf), "You have %i %s remaining.",
                      troops_to_place[PLAYER],
                      troops_to_place[PLAYER] == 1 ? "army" : "armies");
-            font_draw_text(fb, fbw, fbh, fb_stride, STATUS_X, STATUS_INFO_Y,
-                           buf, 0);
+            ui_set_text(&info_widget, buf, 0);
 #endif
 
-            platform_funcs.fb_flush(STATUS_X, 0, fbw - STATUS_X, fbh);
-
             break;
         }
 
@@ -921,23 +1223,21 @@ static void switch_game_phase(GamePhase new_phase)
             attacking_region = defending_region = NULL_REGION;
             origin_region = destination_region = NULL_REGION;
 
-            clear_to_bg(STATUS_X, 0, fbw - STATUS_X, fbh);
-
-            ablitlmt(fb, game_phase_headings[new_phase], STATUS_X,
-                     STATUS_PHASE_Y, headings_w, headings_h, fb_stride,
-                     headings_w * sizeof(uint32_t), STATUS_X, STATUS_PHASE_Y,
-                     fbw, STATUS_PHASE_Y + STATUS_PHASE_H);
+            clear_status();
+            set_heading(&game_phase_headings[new_phase]);
 
             if (party_defeated[PLAYER]) {
-                ablitlmt(fb, defeat_img, 0, 0, fbw, fbh, fb_stride,
-                         fbw * sizeof(uint32_t), STATUS_X, 0, fbw, fbh);
+                ui_set_overlay(&status_ui, defeat_img);
             } else {
-                ablitlmt(fb, victory_img, 0, 0, fbw, fbh, fb_stride,
-                             fbw * sizeof(uint32_t), STATUS_X, 0, fbw, fbh);
+                ui_set_overlay(&status_ui, victory_img);
                 queue_sfx(&victory_snd);
             }
 
-            platform_funcs.fb_flush(STATUS_X, 0, fbw - STATUS_X, fbh);
+            TextCacheStats tcs;
+            text_cache_get_stats(&tcs);
+            printf("[text-cache] %zu hits, %zu misses, %zu evictions\n",
+                   (size_t)tcs.hits, (size_t)tcs.misses,
+                   (size_t)tcs.evictions);
             break;
         }
 
@@ -948,7 +1248,7 @@ static void switch_game_phase(GamePhase new_phase)
     game_phase = new_phase;
 
     if (game_phase == GAME_OVER) {
-        refresh(0, 0, STATUS_X, fbh);
+        REFRESH_INCLUDE(0, 0, STATUS_X, fbh);
     }
 }
 
@@ -1022,22 +1322,11 @@ static bool battle(void)
     qsort(defending_dice, defending_count, sizeof(defending_dice[0]),
           compare_ints_rev);
 
-    int start_y = STATUS_ERROR_Y - (dice_h + 16) * 2;
-    clear_to_bg(STATUS_X, start_y, fbw - STATUS_X, fbh - start_y);
-
-    int y = start_y;
-    for (int i = 0; i < attacking_count; i++) {
-        int x = STATUS_X + (dice_w + 16) * i;
-        ablitlmt(fb, dice_img[attacking_dice[i]], x, y, dice_w, dice_h,
-                 fb_stride, dice_w * sizeof(uint32_t), STATUS_X, 0, fbw, fbh);
-    }
-    y += dice_h + 16;
-    for (int i = 0; i < defending_count; i++) {
-        int x = STATUS_X + (dice_w + 16) * i;
-        ablitlmt(fb, dice_img[defending_dice[i]], x, y, dice_w, dice_h,
-                 fb_stride, dice_w * sizeof(uint32_t), STATUS_X, 0, fbw, fbh);
-    }
-
+    memcpy(shown_dice[0], attacking_dice, sizeof(attacking_dice));
+    memcpy(shown_dice[1], defending_dice, sizeof(defending_dice));
+    shown_dice_count[0] = attacking_count;
+    shown_dice_count[1] = defending_count;
+    ui_invalidate(&dice_widget);
 
     int attacking_losses = 0, defending_losses = 0;
     for (int i = 0; i < MIN(attacking_count, defending_count); i++) {
@@ -1053,14 +1342,12 @@ static bool battle(void)
              "Attacker lost %i %s, defender lost %i %s.",
              attacking_losses, attacking_losses == 1 ? "army" : "armies",
              defending_losses, defending_losses == 1 ? "army" : "armies");
-    font_draw_text(fb, fbw, fbh, fb_stride, STATUS_X, STATUS_ERROR_Y,
-                   casualties, 0);
+    ui_set_icon(&message_widget, NULL, 0, 0);
+    ui_set_text(&message_widget, casualties, 0);
 
     regions[attacking_region].troops -= attacking_losses;
     regions[defending_region].troops -= defending_losses;
 
-    platform_funcs.fb_flush(STATUS_X, start_y, fbw - STATUS_X, fbh - start_y);
-
     if (regions[defending_region].troops) {
         queue_sfx(&battle_snd);
         return false;
@@ -1153,7 +1440,7 @@ static bool trade_in_cards(Party p, Card cards[3])
     }
 
     if (region_match) {
-        refresh(0, 0, STATUS_X, fbh);
+        REFRESH_INCLUDE(0, 0, STATUS_X, fbh);
         queue_sfx(&reinforcements_snd);
     } else {
         queue_sfx(&beep2_snd);
@@ -1194,24 +1481,6 @@ static bool friendly_connection(RegionID origin, RegionID destination)
 }
 
 
-#define REFRESH_INCLUDE(xmin, ymin, xmax, ymax) \
-    do { \
-        refresh_xmin = MIN(refresh_xmin, xmin); \
-        refresh_ymin = MIN(refresh_ymin, ymin); \
-        refresh_xmax = MAX(refresh_xmax, xmax); \
-        refresh_ymax = MAX(refresh_ymax, ymax); \
-    } while (0)
-
-#define REFRESH_INCLUDE_REGION_TROOPS(r) \
-    do { \
-        int hcfw = region_troops_max_w / 2; \
-        int hcfh = region_troops_max_h / 2; \
-        int tpx = regions[(r)].troops_pos.x; \
-        int tpy = regions[(r)].troops_pos.y; \
-        REFRESH_INCLUDE(tpx - hcfw, tpy - hcfh, tpx + hcfw, tpy + hcfh); \
-    } while (0)
-
-
 // TODO: This just has no strategy
 static bool get_ai_battle_params(Party p, RegionID *attacking,
                                  RegionID *attacked, int *attack_count)
@@ -1880,8 +2149,10 @@ static bool trade_in_selected_cards(Party p)
 
 void handle_game(void)
 {
-    int refresh_xmin = fbw, refresh_xmax = 0;
-    int refresh_ymin = fbh, refresh_ymax = 0;
+    if (platform_funcs.fb_back_buffer) {
+        // May have been flipped since the last call
+        fb = platform_funcs.fb_back_buffer();
+    }
 
     if (game_phase == INITIALIZATION) {
         REFRESH_INCLUDE(0, 0, fbw, fbh);
@@ -1994,11 +2265,7 @@ void handle_game(void)
             } else {
                 prompt[0] = 0;
             }
-            clear_to_bg(STATUS_X, STATUS_PROMPT_Y, fbw - STATUS_X, STATUS_PROMPT_H);
-            font_draw_text(fb, fbw, fbh, fb_stride, STATUS_X, STATUS_PROMPT_Y,
-                           prompt, 0);
-            platform_funcs.fb_flush(STATUS_X, STATUS_PROMPT_Y, fbw - STATUS_X,
-                                    STATUS_PROMPT_H);
+            ui_set_text(&prompt_widget, prompt, 0);
         }
     }
 
@@ -2027,10 +2294,11 @@ void handle_game(void)
         }
 
         int new_focused_card;
-        if (mouse_x >= STATUS_X && mouse_y >= STATUS_HAND_Y + 20 &&
+        if (mouse_x >= STATUS_X && mouse_y >= STATUS_HAND_Y + HAND_PLAYER_Y &&
             mouse_y < STATUS_HAND_Y + STATUS_HAND_H)
         {
-            new_focused_card = (mouse_y - STATUS_HAND_Y - 20) / 40;
+            new_focused_card =
+                (mouse_y - STATUS_HAND_Y - HAND_PLAYER_Y) / CARD_H;
             if (new_focused_card >= party_hand_size(PLAYER)) {
                 new_focused_card = -1;
             }
@@ -2067,16 +2335,9 @@ void handle_game(void)
                 refresh_hand();
 
                 if (party_hand_size(PLAYER) < 5) {
-                    clear_to_bg(STATUS_X, STATUS_INFO_Y, fbw - STATUS_X,
-                                STATUS_INFO_H);
-
-                    font_draw_text(fb, fbw, fbh, fb_stride, STATUS_X,
-                                   STATUS_INFO_Y,
-                                   "Press enter to confirm, or the space bar "
-                                   "to skip.", 0);
-
-                    platform_funcs.fb_flush(STATUS_X, STATUS_INFO_Y,
-                                            fbw - STATUS_X, STATUS_INFO_H);
+                    ui_set_text(&info_widget,
+                                "Press enter to confirm, or the space bar "
+                                "to skip.", 0);
                 }
             }
 
@@ -2140,18 +2401,15 @@ void handle_game(void)
         if (ai_needs_to_place_in_prep && !ai_needs_to_place) {
             ai_needs_to_place_in_prep = false;
 
-            clear_to_bg(STATUS_X, STATUS_TODO_Y, fbw - STATUS_X,
-                        STATUS_INFO_Y + STATUS_INFO_H - STATUS_TODO_Y);
-
-            font_draw_text(fb, fbw, fbh, fb_stride, STATUS_X, STATUS_TODO_Y,
+            ui_set_text(&todo_widget,
 #ifdef HAVE_NEUTRAL
-                           "Reinforce your regions by placing two additional "
-                           "armies per turn.",
+                        "Reinforce your regions by placing two additional "
+                        "armies per turn.",
 #else
-                           "Reinforce your regions by placing additional "
-                           "troops.",
+                        "Reinforce your regions by placing additional "
+                        "troops.",
 #endif
-                           0);
+                        0);
 
             char buf[64];
             snprintf(buf, sizeof(buf),
@@ -2159,12 +2417,7 @@ void handle_game(void)
                      troops_to_place[PLAYER],
                      troops_to_place[PLAYER] == 1 ? "army" : "armies");
 
-            font_draw_text(fb, fbw, fbh, fb_stride, STATUS_X, STATUS_INFO_Y,
-                           buf, 0);
-
-            platform_funcs.fb_flush(STATUS_X, STATUS_TODO_Y, fbw - STATUS_X,
-                                    STATUS_INFO_Y + STATUS_INFO_H -
-                                    STATUS_TODO_Y);
+            ui_set_text(&info_widget, buf, 0);
         }
 
         if (ai_needs_to_place_in_prep) {
@@ -2274,25 +2527,22 @@ void handle_game(void)
 #endif
 
         if (unclaimed <= PARTY_COUNT) {
-            clear_to_bg(STATUS_X, STATUS_TODO_Y, fbw - STATUS_X,
-                        STATUS_INFO_Y + STATUS_INFO_H - STATUS_TODO_Y);
-
             bool ai_is_next =
                 game_phase == PREPARATION && preparation_placement_index == 0;
 
-            font_draw_text(fb, fbw, fbh, fb_stride, STATUS_X, STATUS_TODO_Y,
-                           ai_is_next ?
-                                "Wait for your opponent to place troops..." :
-                           preparation_placement_index == 2 ?
-                               "Reinforce the neutral troops with one army." :
+            ui_set_text(&todo_widget,
+                        ai_is_next ?
+                             "Wait for your opponent to place troops..." :
+                        preparation_placement_index == 2 ?
+                            "Reinforce the neutral troops with one army." :
 #ifdef HAVE_NEUTRAL
-                               "Reinforce your regions by placing two additional "
-                               "armies per turn.",
+                            "Reinforce your regions by placing two additional "
+                            "armies per turn.",
 #else
-                               "Reinforce your regions by placing additional "
-                               "troops.",
+                            "Reinforce your regions by placing additional "
+                            "troops.",
 #endif
-                           0);
+                        0);
 
 #ifdef HAVE_NEUTRAL
             p = preparation_placement_index == 2 ? NEUTRAL : PLAYER;
@@ -2314,11 +2564,7 @@ void handle_game(void)
                          troops_to_place[p] == 1 ? "army" : "armies");
             }
 
-            font_draw_text(fb, fbw, fbh, fb_stride, STATUS_X, STATUS_INFO_Y,
-                           buf, 0);
-            platform_funcs.fb_flush(STATUS_X, STATUS_TODO_Y, fbw - STATUS_X,
-                                    STATUS_INFO_Y + STATUS_INFO_H -
-                                    STATUS_TODO_Y);
+            ui_set_text(&info_widget, buf, 0);
         }
 
 
@@ -2405,21 +2651,17 @@ void handle_game(void)
             goto post_logic;
         }
 
-        clear_to_bg(STATUS_X, STATUS_TODO_Y, fbw - STATUS_X, STATUS_TODO_H);
         if (!attacking_region) {
-            font_draw_text(fb, fbw, fbh, fb_stride, STATUS_X, STATUS_TODO_Y,
-                           "Choose a region to attack from.", 0);
+            ui_set_text(&todo_widget, "Choose a region to attack from.", 0);
         } else if (!defending_region) {
-            font_draw_text(fb, fbw, fbh, fb_stride, STATUS_X, STATUS_TODO_Y,
-                           "Choose an enemy-controlled region to attack.", 0);
+            ui_set_text(&todo_widget,
+                        "Choose an enemy-controlled region to attack.", 0);
         } else {
-            font_draw_text(fb, fbw, fbh, fb_stride, STATUS_X, STATUS_TODO_Y,
-                           "Choose how many armies you want to attack with "
-                           "(1, 2, or 3).", 0);
+            ui_set_text(&todo_widget,
+                        "Choose how many armies you want to attack with "
+                        "(1, 2, or 3).", 0);
             integer_prompt = ATTACK_TROOPS_COUNT;
         }
-        platform_funcs.fb_flush(STATUS_X, STATUS_TODO_Y, fbw - STATUS_X,
-                                STATUS_TODO_H);
 
         goto post_logic;
     }
@@ -2462,13 +2704,9 @@ void handle_game(void)
                 integer_prompt_done = CLAIM_TROOPS_COUNT;
                 integer_prompt_value = 0;
             } else {
-                clear_to_bg(STATUS_X, STATUS_TODO_Y, fbw - STATUS_X,
-                            STATUS_TODO_H);
-                font_draw_text(fb, fbw, fbh, fb_stride, STATUS_X, STATUS_TODO_Y,
-                               "Choose how many armies you want to move to the "
-                               "conquered region.", 0);
-                platform_funcs.fb_flush(STATUS_X, STATUS_TODO_Y, fbw - STATUS_X,
-                                        STATUS_TODO_H);
+                ui_set_text(&todo_widget,
+                            "Choose how many armies you want to move to "
+                            "the conquered region.", 0);
 
                 integer_prompt = CLAIM_TROOPS_COUNT;
             }
@@ -2478,19 +2716,11 @@ void handle_game(void)
             // I cannot be lazy and use switch_main_phase(PLAYER, MAIN_BATTLE)
             // here because that would clear the whole side bar, but the dice
             // should stay visible
-            clear_to_bg(STATUS_X, 0, fbw - STATUS_X,
-                        STATUS_INFO_Y + STATUS_INFO_H);
-            ablitlmt(fb, main_phase_headings[MAIN_BATTLE], STATUS_X,
-                     STATUS_PHASE_Y, headings_w, headings_h, fb_stride,
-                     headings_w * sizeof(uint32_t), STATUS_X, STATUS_PHASE_Y,
-                     fbw, STATUS_PHASE_Y + STATUS_PHASE_H);
-            font_draw_text(fb, fbw, fbh, fb_stride, STATUS_X, STATUS_TODO_Y,
-                           "Choose a region to attack from.", 0);
-            font_draw_text(fb, fbw, fbh, fb_stride, STATUS_X, STATUS_INFO_Y,
-                           "Press the space bar to end the battle phase.",
-                           0);
-            platform_funcs.fb_flush(STATUS_X, 0, fbw - STATUS_X,
-                                    STATUS_INFO_Y + STATUS_INFO_H);
+            set_heading(&main_phase_headings[MAIN_BATTLE]);
+            ui_set_text(&todo_widget, "Choose a region to attack from.", 0);
+            ui_set_text(&info_widget,
+                        "Press the space bar to end the battle phase.",
+                        0);
         }
 
         goto post_logic;
@@ -2563,15 +2793,12 @@ void handle_game(void)
             defending_count = 1;
             ai_waiting_for_defending_count = false;
         } else if (!integer_prompt && !integer_prompt_done) {
-            clear_to_bg(STATUS_X, STATUS_TODO_Y, fbw - STATUS_X, STATUS_TODO_H);
-            font_draw_text(fb, fbw, fbh, fb_stride, STATUS_X, STATUS_TODO_Y,
-                           p == PLAYER ? "Choose how many armies you want to "
-                                         "defend with (1 or 2)."
-                                       : "Choose how many neutral armies "
-                                         "should be used for defense (1 or 2).",
-                           0);
-            platform_funcs.fb_flush(STATUS_X, STATUS_TODO_Y, fbw - STATUS_X,
-                                    STATUS_TODO_Y);
+            ui_set_text(&todo_widget,
+                        p == PLAYER ? "Choose how many armies you want to "
+                                      "defend with (1 or 2)."
+                                    : "Choose how many neutral armies "
+                                      "should be used for defense (1 or 2).",
+                        0);
 
             // Notify the player because they may have stopped paying
             // attention during their opponent's turn
@@ -2599,10 +2826,7 @@ void handle_game(void)
             }
 
             if (defending_count) {
-                clear_to_bg(STATUS_X, STATUS_TODO_Y, fbw - STATUS_X,
-                            STATUS_TODO_H);
-                platform_funcs.fb_flush(STATUS_X, STATUS_TODO_Y, fbw - STATUS_X,
-                                        STATUS_TODO_Y);
+                ui_set_text(&todo_widget, "", 0);
 
                 ai_waiting_for_defending_count = false;
             }
@@ -2662,23 +2886,20 @@ void handle_game(void)
             goto post_logic;
         }
 
-        clear_to_bg(STATUS_X, STATUS_TODO_Y, fbw - STATUS_X, STATUS_TODO_H);
         if (!origin_region) {
-            font_draw_text(fb, fbw, fbh, fb_stride, STATUS_X, STATUS_TODO_Y,
-                           "Choose one region to move troops from.", 0);
+            ui_set_text(&todo_widget,
+                        "Choose one region to move troops from.", 0);
         } else if (!destination_region) {
-            font_draw_text(fb, fbw, fbh, fb_stride, STATUS_X, STATUS_TODO_Y,
-                           "Choose one region to move troops to.", 0);
+            ui_set_text(&todo_widget,
+                        "Choose one region to move troops to.", 0);
         } else {
             // Should have been caught by the conditions above
             assert(destination_region != origin_region);
 
-            font_draw_text(fb, fbw, fbh, fb_stride, STATUS_X, STATUS_TODO_Y,
-                           "Choose how many armies you want to move.", 0);
+            ui_set_text(&todo_widget,
+                        "Choose how many armies you want to move.", 0);
             integer_prompt = MOVE_TROOPS_COUNT;
         }
-        platform_funcs.fb_flush(STATUS_X, STATUS_TODO_Y, fbw - STATUS_X,
-                                STATUS_TODO_H);
 
         goto post_logic;
     }
@@ -2753,7 +2974,7 @@ void handle_game(void)
     }
 
 post_logic:
-    if (refresh_xmax > refresh_xmin) {
-        refresh(refresh_xmin, refresh_ymin, refresh_xmax, refresh_ymax);
-    }
+    ui_render(&status_ui, fb, fb_stride, &frame_draw.damage);
+    record_map(&frame_draw);
+    draw_list_execute(&frame_draw, fb, fb_stride);
 }
@@ -1,5 +1,6 @@
 #include <assert.h>
 #include <errno.h>
+#include <image.h>
 #include <nonstddef.h>
 #include <png.h>
 #include <stdbool.h>
@@ -13,6 +14,10 @@
 static const char *current_png;
 static bool png_had_error;
 
+// Factor for load_scaled_image() (to / from)
+static int scale_to_w = 1, scale_from_w = 1;
+static int scale_to_h = 1, scale_from_h = 1;
+
 
 static void png_error_func(png_struct *png, const char *msg)
 {
@@ -102,3 +107,403 @@ fail:
 
     return ret;
 }
+
+
+void image_set_scale(int to_w, int from_w, int to_h, int from_h)
+{
+    assert(to_w > 0 && from_w > 0 && to_h > 0 && from_h > 0);
+
+    scale_to_w = to_w;
+    scale_from_w = from_w;
+    scale_to_h = to_h;
+    scale_from_h = from_h;
+}
+
+
+static uint32_t premultiply(uint32_t px);
+
+static uint32_t unpremultiply(uint32_t px)
+{
+    uint32_t a = px >> 24;
+    if (!a || a == 0xff) {
+        return a ? px : 0;
+    }
+
+    uint32_t r = MIN(((px >> 16) & 0xff) * 255 + a / 2, a * 255) / a;
+    uint32_t g = MIN(((px >> 8) & 0xff) * 255 + a / 2, a * 255) / a;
+    uint32_t b = MIN((px & 0xff) * 255 + a / 2, a * 255) / a;
+
+    return (a << 24) | (r << 16) | (g << 8) | b;
+}
+
+
+// Interpolates each channel of @a and @b with @w (0..256) as the
+// weight of @b; channels are kept in 16 bits
+static void lerp_channels(const uint32_t *a, const uint32_t *b, int w,
+                          uint32_t *out)
+{
+    for (int c = 0; c < 4; c++) {
+        out[c] = a[c] * (256 - w) + b[c] * w;
+    }
+}
+
+
+static void split_channels(uint32_t px, uint32_t *out)
+{
+    for (int c = 0; c < 4; c++) {
+        out[c] = (px >> (c * 8)) & 0xff;
+    }
+}
+
+
+// Source coordinate (16.16 fixed point) that destination pixel @d maps
+// to, when sampling at pixel centers
+static int64_t source_pos(int d, int src_size, int dst_size)
+{
+    return (((int64_t)(2 * d + 1) * src_size) << 16) / (2 * dst_size)
+           - 0x8000;
+}
+
+
+void scale_image(const uint32_t *src, int sw, int sh, size_t sstride,
+                 uint32_t *dst, int dw, int dh, size_t dstride,
+                 enum ScaleFilter filter)
+{
+    for (int y = 0; y < dh; y++) {
+        int64_t fy = MAX(source_pos(y, sh, dh), 0);
+        int sy0 = MIN(fy >> 16, sh - 1);
+        int sy1 = MIN(sy0 + 1, sh - 1);
+        int wy = (fy >> 8) & 0xff;
+
+        const uint32_t *row0 = (const uint32_t *)((const char *)src
+                                                  + sy0 * sstride);
+        const uint32_t *row1 = (const uint32_t *)((const char *)src
+                                                  + sy1 * sstride);
+        uint32_t *drow = (uint32_t *)((char *)dst + y * dstride);
+
+        for (int x = 0; x < dw; x++) {
+            int64_t fx = MAX(source_pos(x, sw, dw), 0);
+            int sx0 = MIN(fx >> 16, sw - 1);
+
+            if (filter == SCALE_NEAREST) {
+                // Round to the nearest source pixel
+                int sx = MIN((fx + 0x8000) >> 16, sw - 1);
+                int sy = MIN((fy + 0x8000) >> 16, sh - 1);
+                drow[x] = ((const uint32_t *)((const char *)src
+                                              + sy * sstride))[sx];
+                continue;
+            }
+
+            int sx1 = MIN(sx0 + 1, sw - 1);
+            int wx = (fx >> 8) & 0xff;
+
+            // Interpolate premultiplied, so transparent pixels' colors
+            // do not bleed into their neighbors
+            uint32_t p00[4], p01[4], p10[4], p11[4], top[4], bottom[4];
+            split_channels(premultiply(row0[sx0]), p00);
+            split_channels(premultiply(row0[sx1]), p01);
+            split_channels(premultiply(row1[sx0]), p10);
+            split_channels(premultiply(row1[sx1]), p11);
+
+            lerp_channels(p00, p01, wx, top);
+            lerp_channels(p10, p11, wx, bottom);
+
+            uint32_t px = 0;
+            for (int c = 0; c < 4; c++) {
+                uint32_t v = (top[c] * (256 - wy) + bottom[c] * wy) >> 16;
+                px |= MIN(v, 0xffu) << (c * 8);
+            }
+
+            drow[x] = unpremultiply(px);
+        }
+    }
+}
+
+
+bool load_scaled_image(const char *name, uint32_t **dest, int *w, int *h,
+                       int stride, enum ScaleFilter filter)
+{
+    uint32_t *img = NULL;
+    int img_w = 0, img_h = 0;
+
+    if (!load_image(name, &img, &img_w, &img_h, 0)) {
+        free(img);
+        return false;
+    }
+
+    if (!*w) {
+        *w = MAX(img_w * scale_to_w / scale_from_w, 1);
+    }
+    if (!*h) {
+        *h = MAX(img_h * scale_to_h / scale_from_h, 1);
+    }
+
+    stride = MAX(stride, (int)(*w * sizeof(uint32_t)));
+
+    if (!*dest) {
+        *dest = malloc(*h * stride);
+    }
+
+    if (*w == img_w && *h == img_h) {
+        for (int y = 0; y < img_h; y++) {
+            memcpy((char *)*dest + y * stride, img + y * img_w,
+                   img_w * sizeof(uint32_t));
+        }
+    } else {
+        scale_image(img, img_w, img_h, img_w * sizeof(uint32_t),
+                    *dest, *w, *h, stride, filter);
+    }
+
+    free(img);
+    return true;
+}
+
+
+void tint_image(uint32_t *img, int w, int h, size_t stride,
+                const ColorMatrix *m)
+{
+    for (int y = 0; y < h; y++) {
+        uint32_t *row = (uint32_t *)((char *)img + y * stride);
+
+        for (int x = 0; x < w; x++) {
+            int in[3] = {
+                (row[x] >> 16) & 0xff,
+                (row[x] >> 8) & 0xff,
+                row[x] & 0xff,
+            };
+            uint32_t px = row[x] & 0xff000000;
+
+            for (int c = 0; c < 3; c++) {
+                int v = m->m[c][0] * in[0] + m->m[c][1] * in[1]
+                      + m->m[c][2] * in[2] + m->m[c][3] * 255;
+                v = (v + COLOR_MATRIX_ONE / 2) / COLOR_MATRIX_ONE;
+                px |= (uint32_t)MIN(MAX(v, 0), 255) << (16 - c * 8);
+            }
+
+            row[x] = px;
+        }
+    }
+}
+
+
+static enum SpanType pixel_span_type(uint32_t px)
+{
+    switch (px >> 24) {
+        case 0x00: return SPAN_SKIP;
+        case 0xff: return SPAN_OPAQUE;
+        default:   return SPAN_BLEND;
+    }
+}
+
+
+static uint32_t premultiply(uint32_t px)
+{
+    uint32_t a = px >> 24;
+
+    // c * a fits into 16 bits, so we can do r and b in one go; then
+    // divide by 255 (rounding) as (x + (x >> 8)) >> 8
+    uint32_t rb = (px & 0xff00ff) * a + 0x800080;
+    uint32_t g = (px & 0x00ff00) * a + 0x008000;
+
+    rb = ((rb + ((rb >> 8) & 0xff00ff)) >> 8) & 0xff00ff;
+    g = ((g + ((g >> 8) & 0x00ff00)) >> 8) & 0x00ff00;
+
+    return (a << 24) | rb | g;
+}
+
+
+// If @dest's arrays are NULL, only count the spans and pixels needed
+static void do_span_encode(const uint32_t *img, int w, int h, SpanImage *dest,
+                           size_t *span_count, size_t *pixel_count)
+{
+    size_t si = 0, pi = 0;
+
+    for (int y = 0; y < h; y++) {
+        const uint32_t *row = img + y * w;
+
+        if (dest->rows) {
+            dest->rows[y].span = si;
+            dest->rows[y].pixel = pi;
+        }
+
+        int end = w;
+        while (end > 0 && pixel_span_type(row[end - 1]) == SPAN_SKIP) {
+            end--;
+        }
+
+        int x = 0;
+        while (x < end) {
+            enum SpanType type = pixel_span_type(row[x]);
+            int len = 1;
+            while (x + len < end && len < SPAN_MAX_LENGTH &&
+                   pixel_span_type(row[x + len]) == type)
+            {
+                len++;
+            }
+
+            if (dest->spans) {
+                dest->spans[si] = SPAN(type, len);
+            }
+            si++;
+
+            if (type != SPAN_SKIP) {
+                if (dest->pixels) {
+                    for (int i = 0; i < len; i++) {
+                        dest->pixels[pi + i] = type == SPAN_OPAQUE
+                                             ? row[x + i]
+                                             : premultiply(row[x + i]);
+                    }
+                }
+                pi += len;
+            }
+
+            x += len;
+        }
+    }
+
+    if (dest->rows) {
+        dest->rows[h].span = si;
+        dest->rows[h].pixel = pi;
+    }
+
+    *span_count = si;
+    *pixel_count = pi;
+}
+
+
+bool span_encode_image(const uint32_t *img, int w, int h, SpanImage *dest)
+{
+    size_t span_count, pixel_count;
+
+    *dest = (SpanImage){
+        .w = w,
+        .h = h,
+    };
+
+    do_span_encode(img, w, h, dest, &span_count, &pixel_count);
+
+    dest->rows = malloc((h + 1) * sizeof(dest->rows[0]));
+    dest->spans = malloc(span_count * sizeof(dest->spans[0]));
+    dest->pixels = malloc(pixel_count * sizeof(dest->pixels[0]));
+
+    // Without all of them, the second pass would only count again
+    if (!dest->rows || (span_count && !dest->spans) ||
+        (pixel_count && !dest->pixels))
+    {
+        free_span_image(dest);
+        return false;
+    }
+
+    do_span_encode(img, w, h, dest, &span_count, &pixel_count);
+    return true;
+}
+
+
+bool load_span_image(const char *name, SpanImage *dest, int *w, int *h)
+{
+    uint32_t *img = NULL;
+
+    if (!load_scaled_image(name, &img, w, h, 0, SCALE_NEAREST)) {
+        free(img);
+        return false;
+    }
+
+    bool ret = span_encode_image(img, *w, *h, dest);
+    if (!ret) {
+        printf("[image] %s: Out of memory\n", name);
+    }
+
+    free(img);
+    return ret;
+}
+
+
+void free_span_image(SpanImage *img)
+{
+    free(img->rows);
+    free(img->spans);
+    free(img->pixels);
+
+    *img = (SpanImage){ 0 };
+}
+
+
+// Power of two, and enough so that the table is never more than half
+// full
+#define INDEX_HASH_SIZE (4 * INDEXED_MAX_COLORS)
+
+bool index_image(const uint32_t *img, int w, int h, size_t stride,
+                 IndexedImage *dest)
+{
+    // Open addressing; entries are LUT index + 1, so 0 is free
+    uint16_t hash[INDEX_HASH_SIZE] = { 0 };
+
+    *dest = (IndexedImage){
+        .w = w,
+        .h = h,
+        .pixels = malloc(w * h),
+    };
+
+    if (!dest->pixels) {
+        return false;
+    }
+
+    for (int y = 0; y < h; y++) {
+        const uint32_t *row = (const uint32_t *)((const char *)img
+                                                 + y * stride);
+
+        for (int x = 0; x < w; x++) {
+            // Colors that only differ in what is invisible anyway are
+            // the same entry
+            uint32_t px = premultiply(row[x]);
+
+            uint32_t slot = (px * 0x9e3779b1u) % INDEX_HASH_SIZE;
+            while (hash[slot] && dest->lut[hash[slot] - 1] != px) {
+                slot = (slot + 1) % INDEX_HASH_SIZE;
+            }
+
+            if (!hash[slot]) {
+                if (dest->colors == INDEXED_MAX_COLORS) {
+                    free_indexed_image(dest);
+                    return false;
+                }
+
+                dest->lut[dest->colors++] = px;
+                hash[slot] = dest->colors;
+            }
+
+            dest->pixels[y * w + x] = hash[slot] - 1;
+        }
+    }
+
+    return true;
+}
+
+
+bool load_indexed_image(const char *name, IndexedImage *dest, int *w, int *h)
+{
+    uint32_t *img = NULL;
+
+    // Filtering would only add colors
+    if (!load_scaled_image(name, &img, w, h, 0, SCALE_NEAREST)) {
+        free(img);
+        return false;
+    }
+
+    bool ret = index_image(img, *w, *h, *w * sizeof(uint32_t), dest);
+    if (!ret) {
+        printf("[image] %s: More than %i colors, or out of memory\n",
+               name, INDEXED_MAX_COLORS);
+    }
+
+    free(img);
+    return ret;
+}
+
+
+void free_indexed_image(IndexedImage *img)
+{
+    free(img->pixels);
+
+    *img = (IndexedImage){ 0 };
+}
@@ -20,304 +20,9 @@ void init_incbinfs(void)
      * Exceptions are marked with exclamation mark comments. */
 
     REF("/abort.png", abort_png);
+    REF("/army-digits.png", army_digits_png);
     REF("/army-none.png", army_none_png);
-    REF("/army-blue-1.png", army_blue_1_png);
-    REF("/army-blue-2.png", army_blue_2_png);
-    REF("/army-blue-3.png", army_blue_3_png);
-    REF("/army-blue-4.png", army_blue_4_png);
-    REF("/army-blue-5.png", army_blue_5_png);
-    REF("/army-blue-6.png", army_blue_6_png);
-    REF("/army-blue-7.png", army_blue_7_png);
-    REF("/army-blue-8.png", army_blue_8_png);
-    REF("/army-blue-9.png", army_blue_9_png);
-    REF("/army-blue-10.png", army_blue_10_png);
-    REF("/army-blue-11.png", army_blue_11_png);
-    REF("/army-blue-12.png", army_blue_12_png);
-    REF("/army-blue-13.png", army_blue_13_png);
-    REF("/army-blue-14.png", army_blue_14_png);
-    REF("/army-blue-15.png", army_blue_15_png);
-    REF("/army-blue-16.png", army_blue_16_png);
-    REF("/army-blue-17.png", army_blue_17_png);
-    REF("/army-blue-18.png", army_blue_18_png);
-    REF("/army-blue-19.png", army_blue_19_png);
-    REF("/army-blue-20.png", army_blue_20_png);
-    REF("/army-blue-21.png", army_blue_21_png);
-    REF("/army-blue-22.png", army_blue_22_png);
-    REF("/army-blue-23.png", army_blue_23_png);
-    REF("/army-blue-24.png", army_blue_24_png);
-    REF("/army-blue-25.png", army_blue_25_png);
-    REF("/army-blue-26.png", army_blue_26_png);
-    REF("/army-blue-27.png", army_blue_27_png);
-    REF("/army-blue-28.png", army_blue_28_png);
-    REF("/army-blue-29.png", army_blue_29_png);
-    REF("/army-blue-30.png", army_blue_30_png);
-    REF("/army-blue-31.png", army_blue_31_png);
-    REF("/army-blue-32.png", army_blue_32_png);
-    REF("/army-blue-33.png", army_blue_33_png);
-    REF("/army-blue-34.png", army_blue_34_png);
-    REF("/army-blue-35.png", army_blue_35_png);
-    REF("/army-blue-36.png", army_blue_36_png);
-    REF("/army-blue-37.png", army_blue_37_png);
-    REF("/army-blue-38.png", army_blue_38_png);
-    REF("/army-blue-39.png", army_blue_39_png);
-    REF("/army-blue-40.png", army_blue_40_png);
-    REF("/army-blue-41.png", army_blue_41_png);
-    REF("/army-blue-42.png", army_blue_42_png);
-    REF("/army-blue-43.png", army_blue_43_png);
-    REF("/army-blue-44.png", army_blue_44_png);
-    REF("/army-blue-45.png", army_blue_45_png);
-    REF("/army-blue-46.png", army_blue_46_png);
-    REF("/army-blue-47.png", army_blue_47_png);
-    REF("/army-blue-48.png", army_blue_48_png);
-    REF("/army-blue-49.png", army_blue_49_png);
-    REF("/army-blue-50.png", army_blue_50_png);
-    REF("/army-blue-51.png", army_blue_51_png);
-    REF("/army-blue-52.png", army_blue_52_png);
-    REF("/army-blue-53.png", army_blue_53_png);
-    REF("/army-blue-54.png", army_blue_54_png);
-    REF("/army-blue-55.png", army_blue_55_png);
-    REF("/army-blue-56.png", army_blue_56_png);
-    REF("/army-blue-57.png", army_blue_57_png);
-    REF("/army-blue-58.png", army_blue_58_png);
-    REF("/army-blue-59.png", army_blue_59_png);
-    REF("/army-blue-60.png", army_blue_60_png);
-    REF("/army-blue-61.png", army_blue_61_png);
-    REF("/army-blue-62.png", army_blue_62_png);
-    REF("/army-blue-63.png", army_blue_63_png);
-    REF("/army-blue-64.png", army_blue_64_png);
-    REF("/army-blue-65.png", army_blue_65_png);
-    REF("/army-blue-66.png", army_blue_66_png);
-    REF("/army-blue-67.png", army_blue_67_png);
-    REF("/army-blue-68.png", army_blue_68_png);
-    REF("/army-blue-69.png", army_blue_69_png);
-    REF("/army-blue-70.png", army_blue_70_png);
-    REF("/army-blue-71.png", army_blue_71_png);
-    REF("/army-blue-72.png", army_blue_72_png);
-    REF("/army-blue-73.png", army_blue_73_png);
-    REF("/army-blue-74.png", army_blue_74_png);
-    REF("/army-blue-75.png", army_blue_75_png);
-    REF("/army-blue-76.png", army_blue_76_png);
-    REF("/army-blue-77.png", army_blue_77_png);
-    REF("/army-blue-78.png", army_blue_78_png);
-    REF("/army-blue-79.png", army_blue_79_png);
-    REF("/army-blue-80.png", army_blue_80_png);
-    REF("/army-blue-81.png", army_blue_81_png);
-    REF("/army-blue-82.png", army_blue_82_png);
-    REF("/army-blue-83.png", army_blue_83_png);
-    REF("/army-blue-84.png", army_blue_84_png);
-    REF("/army-blue-85.png", army_blue_85_png);
-    REF("/army-blue-86.png", army_blue_86_png);
-    REF("/army-blue-87.png", army_blue_87_png);
-    REF("/army-blue-88.png", army_blue_88_png);
-    REF("/army-blue-89.png", army_blue_89_png);
-    REF("/army-blue-90.png", army_blue_90_png);
-    REF("/army-blue-91.png", army_blue_91_png);
-    REF("/army-blue-92.png", army_blue_92_png);
-    REF("/army-blue-93.png", army_blue_93_png);
-    REF("/army-blue-94.png", army_blue_94_png);
-    REF("/army-blue-95.png", army_blue_95_png);
-    REF("/army-blue-96.png", army_blue_96_png);
-    REF("/army-blue-97.png", army_blue_97_png);
-    REF("/army-blue-98.png", army_blue_98_png);
-    REF("/army-blue-99.png", army_blue_99_png);
-    REF("/army-gray-1.png", army_gray_1_png);
-    REF("/army-gray-2.png", army_gray_2_png);
-    REF("/army-gray-3.png", army_gray_3_png);
-    REF("/army-gray-4.png", army_gray_4_png);
-    REF("/army-gray-5.png", army_gray_5_png);
-    REF("/army-gray-6.png", army_gray_6_png);
-    REF("/army-gray-7.png", army_gray_7_png);
-    REF("/army-gray-8.png", army_gray_8_png);
-    REF("/army-gray-9.png", army_gray_9_png);
-    REF("/army-gray-10.png", army_gray_10_png);
-    REF("/army-gray-11.png", army_gray_11_png);
-    REF("/army-gray-12.png", army_gray_12_png);
-    REF("/army-gray-13.png", army_gray_13_png);
-    REF("/army-gray-14.png", army_gray_14_png);
-    REF("/army-gray-15.png", army_gray_15_png);
-    REF("/army-gray-16.png", army_gray_16_png);
-    REF("/army-gray-17.png", army_gray_17_png);
-    REF("/army-gray-18.png", army_gray_18_png);
-    REF("/army-gray-19.png", army_gray_19_png);
-    REF("/army-gray-20.png", army_gray_20_png);
-    REF("/army-gray-21.png", army_gray_21_png);
-    REF("/army-gray-22.png", army_gray_22_png);
-    REF("/army-gray-23.png", army_gray_23_png);
-    REF("/army-gray-24.png", army_gray_24_png);
-    REF("/army-gray-25.png", army_gray_25_png);
-    REF("/army-gray-26.png", army_gray_26_png);
-    REF("/army-gray-27.png", army_gray_27_png);
-    REF("/army-gray-28.png", army_gray_28_png);
-    REF("/army-gray-29.png", army_gray_29_png);
-    REF("/army-gray-30.png", army_gray_30_png);
-    REF("/army-gray-31.png", army_gray_31_png);
-    REF("/army-gray-32.png", army_gray_32_png);
-    REF("/army-gray-33.png", army_gray_33_png);
-    REF("/army-gray-34.png", army_gray_34_png);
-    REF("/army-gray-35.png", army_gray_35_png);
-    REF("/army-gray-36.png", army_gray_36_png);
-    REF("/army-gray-37.png", army_gray_37_png);
-    REF("/army-gray-38.png", army_gray_38_png);
-    REF("/army-gray-39.png", army_gray_39_png);
-    REF("/army-gray-40.png", army_gray_40_png);
-    REF("/army-gray-41.png", army_gray_41_png);
-    REF("/army-gray-42.png", army_gray_42_png);
-    REF("/army-gray-43.png", army_gray_43_png);
-    REF("/army-gray-44.png", army_gray_44_png);
-    REF("/army-gray-45.png", army_gray_45_png);
-    REF("/army-gray-46.png", army_gray_46_png);
-    REF("/army-gray-47.png", army_gray_47_png);
-    REF("/army-gray-48.png", army_gray_48_png);
-    REF("/army-gray-49.png", army_gray_49_png);
-    REF("/army-gray-50.png", army_gray_50_png);
-    REF("/army-gray-51.png", army_gray_51_png);
-    REF("/army-gray-52.png", army_gray_52_png);
-    REF("/army-gray-53.png", army_gray_53_png);
-    REF("/army-gray-54.png", army_gray_54_png);
-    REF("/army-gray-55.png", army_gray_55_png);
-    REF("/army-gray-56.png", army_gray_56_png);
-    REF("/army-gray-57.png", army_gray_57_png);
-    REF("/army-gray-58.png", army_gray_58_png);
-    REF("/army-gray-59.png", army_gray_59_png);
-    REF("/army-gray-60.png", army_gray_60_png);
-    REF("/army-gray-61.png", army_gray_61_png);
-    REF("/army-gray-62.png", army_gray_62_png);
-    REF("/army-gray-63.png", army_gray_63_png);
-    REF("/army-gray-64.png", army_gray_64_png);
-    REF("/army-gray-65.png", army_gray_65_png);
-    REF("/army-gray-66.png", army_gray_66_png);
-    REF("/army-gray-67.png", army_gray_67_png);
-    REF("/army-gray-68.png", army_gray_68_png);
-    REF("/army-gray-69.png", army_gray_69_png);
-    REF("/army-gray-70.png", army_gray_70_png);
-    REF("/army-gray-71.png", army_gray_71_png);
-    REF("/army-gray-72.png", army_gray_72_png);
-    REF("/army-gray-73.png", army_gray_73_png);
-    REF("/army-gray-74.png", army_gray_74_png);
-    REF("/army-gray-75.png", army_gray_75_png);
-    REF("/army-gray-76.png", army_gray_76_png);
-    REF("/army-gray-77.png", army_gray_77_png);
-    REF("/army-gray-78.png", army_gray_78_png);
-    REF("/army-gray-79.png", army_gray_79_png);
-    REF("/army-gray-80.png", army_gray_80_png);
-    REF("/army-gray-81.png", army_gray_81_png);
-    REF("/army-gray-82.png", army_gray_82_png);
-    REF("/army-gray-83.png", army_gray_83_png);
-    REF("/army-gray-84.png", army_gray_84_png);
-    REF("/army-gray-85.png", army_gray_85_png);
-    REF("/army-gray-86.png", army_gray_86_png);
-    REF("/army-gray-87.png", army_gray_87_png);
-    REF("/army-gray-88.png", army_gray_88_png);
-    REF("/army-gray-89.png", army_gray_89_png);
-    REF("/army-gray-90.png", army_gray_90_png);
-    REF("/army-gray-91.png", army_gray_91_png);
-    REF("/army-gray-92.png", army_gray_92_png);
-    REF("/army-gray-93.png", army_gray_93_png);
-    REF("/army-gray-94.png", army_gray_94_png);
-    REF("/army-gray-95.png", army_gray_95_png);
-    REF("/army-gray-96.png", army_gray_96_png);
-    REF("/army-gray-97.png", army_gray_97_png);
-    REF("/army-gray-98.png", army_gray_98_png);
-    REF("/army-gray-99.png", army_gray_99_png);
-    REF("/army-red-1.png", army_red_1_png);
-    REF("/army-red-2.png", army_red_2_png);
-    REF("/army-red-3.png", army_red_3_png);
-    REF("/army-red-4.png", army_red_4_png);
-    REF("/army-red-5.png", army_red_5_png);
-    REF("/army-red-6.png", army_red_6_png);
-    REF("/army-red-7.png", army_red_7_png);
-    REF("/army-red-8.png", army_red_8_png);
-    REF("/army-red-9.png", army_red_9_png);
-    REF("/army-red-10.png", army_red_10_png);
-    REF("/army-red-11.png", army_red_11_png);
-    REF("/army-red-12.png", army_red_12_png);
-    REF("/army-red-13.png", army_red_13_png);
-    REF("/army-red-14.png", army_red_14_png);
-    REF("/army-red-15.png", army_red_15_png);
-    REF("/army-red-16.png", army_red_16_png);
-    REF("/army-red-17.png", army_red_17_png);
-    REF("/army-red-18.png", army_red_18_png);
-    REF("/army-red-19.png", army_red_19_png);
-    REF("/army-red-20.png", army_red_20_png);
-    REF("/army-red-21.png", army_red_21_png);
-    REF("/army-red-22.png", army_red_22_png);
-    REF("/army-red-23.png", army_red_23_png);
-    REF("/army-red-24.png", army_red_24_png);
-    REF("/army-red-25.png", army_red_25_png);
-    REF("/army-red-26.png", army_red_26_png);
-    REF("/army-red-27.png", army_red_27_png);
-    REF("/army-red-28.png", army_red_28_png);
-    REF("/army-red-29.png", army_red_29_png);
-    REF("/army-red-30.png", army_red_30_png);
-    REF("/army-red-31.png", army_red_31_png);
-    REF("/army-red-32.png", army_red_32_png);
-    REF("/army-red-33.png", army_red_33_png);
-    REF("/army-red-34.png", army_red_34_png);
-    REF("/army-red-35.png", army_red_35_png);
-    REF("/army-red-36.png", army_red_36_png);
-    REF("/army-red-37.png", army_red_37_png);
-    REF("/army-red-38.png", army_red_38_png);
-    REF("/army-red-39.png", army_red_39_png);
-    REF("/army-red-40.png", army_red_40_png);
-    REF("/army-red-41.png", army_red_41_png);
-    REF("/army-red-42.png", army_red_42_png);
-    REF("/army-red-43.png", army_red_43_png);
-    REF("/army-red-44.png", army_red_44_png);
-    REF("/army-red-45.png", army_red_45_png);
-    REF("/army-red-46.png", army_red_46_png);
-    REF("/army-red-47.png", army_red_47_png);
-    REF("/army-red-48.png", army_red_48_png);
-    REF("/army-red-49.png", army_red_49_png);
-    REF("/army-red-50.png", army_red_50_png);
-    REF("/army-red-51.png", army_red_51_png);
-    REF("/army-red-52.png", army_red_52_png);
-    REF("/army-red-53.png", army_red_53_png);
-    REF("/army-red-54.png", army_red_54_png);
-    REF("/army-red-55.png", army_red_55_png);
-    REF("/army-red-56.png", army_red_56_png);
-    REF("/army-red-57.png", army_red_57_png);
-    REF("/army-red-58.png", army_red_58_png);
-    REF("/army-red-59.png", army_red_59_png);
-    REF("/army-red-60.png", army_red_60_png);
-    REF("/army-red-61.png", army_red_61_png);
-    REF("/army-red-62.png", army_red_62_png);
-    REF("/army-red-63.png", army_red_63_png);
-    REF("/army-red-64.png", army_red_64_png);
-    REF("/army-red-65.png", army_red_65_png);
-    REF("/army-red-66.png", army_red_66_png);
-    REF("/army-red-67.png", army_red_67_png);
-    REF("/army-red-68.png", army_red_68_png);
-    REF("/army-red-69.png", army_red_69_png);
-    REF("/army-red-70.png", army_red_70_png);
-    REF("/army-red-71.png", army_red_71_png);
-    REF("/army-red-72.png", army_red_72_png);
-    REF("/army-red-73.png", army_red_73_png);
-    REF("/army-red-74.png", army_red_74_png);
-    REF("/army-red-75.png", army_red_75_png);
-    REF("/army-red-76.png", army_red_76_png);
-    REF("/army-red-77.png", army_red_77_png);
-    REF("/army-red-78.png", army_red_78_png);
-    REF("/army-red-79.png", army_red_79_png);
-    REF("/army-red-80.png", army_red_80_png);
-    REF("/army-red-81.png", army_red_81_png);
-    REF("/army-red-82.png", army_red_82_png);
-    REF("/army-red-83.png", army_red_83_png);
-    REF("/army-red-84.png", army_red_84_png);
-    REF("/army-red-85.png", army_red_85_png);
-    REF("/army-red-86.png", army_red_86_png);
-    REF("/army-red-87.png", army_red_87_png);
-    REF("/army-red-88.png", army_red_88_png);
-    REF("/army-red-89.png", army_red_89_png);
-    REF("/army-red-90.png", army_red_90_png);
-    REF("/army-red-91.png", army_red_91_png);
-    REF("/army-red-92.png", army_red_92_png);
-    REF("/army-red-93.png", army_red_93_png);
-    REF("/army-red-94.png", army_red_94_png);
-    REF("/army-red-95.png", army_red_95_png);
-    REF("/army-red-96.png", army_red_96_png);
-    REF("/army-red-97.png", army_red_97_png);
-    REF("/army-red-98.png", army_red_98_png);
-    REF("/army-red-99.png", army_red_99_png);
+    REF("/army-token.png", army_token_png);
     REF("/attacked-region.png", attacked_region_png);
     REF("/attacking-region.png", attacking_region_png);
     REF("/battle.ogg", battle_ogg);
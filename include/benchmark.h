@@ -0,0 +1,7 @@
+#ifndef _BENCHMARK_H
+#define _BENCHMARK_H
+
+// Does nothing unless compiled with BENCHMARK=1
+void run_benchmarks(void);
+
+#endif
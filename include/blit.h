@@ -0,0 +1,47 @@
+#ifndef _BLIT_H
+#define _BLIT_H
+
+#include <image.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+// Blends @n pixels from @src over @dst.  @src is BGRA (straight
+// alpha), @dst is BGRX; the result is always opaque.
+typedef void (*ABlitRowFunc)(uint32_t *dst, const uint32_t *src, size_t n);
+
+// Selected by init_blit(), may be swapped out for benchmarking
+extern ABlitRowFunc ablit_row;
+
+void ablit_row_scalar(uint32_t *dst, const uint32_t *src, size_t n);
+// Only valid to call if blit_have_rvv() returns true
+void ablit_row_rvv(uint32_t *dst, const uint32_t *src, size_t n);
+
+// Like ablit_row_scalar(), but @src is premultiplied
+void ablit_row_premul(uint32_t *dst, const uint32_t *src, size_t n);
+// Like ablit_row_premul(), but @src are indices into @lut
+void iblit_row(uint32_t *dst, const uint8_t *src, const uint32_t *lut,
+               size_t n);
+
+
+void init_blit(void);
+bool blit_have_rvv(void);
+
+// Alpha-blits the @sw x @sh image @src to @dx/@dy in @dst, limited to
+// the rectangle @xmin/@ymin (inclusive) to @xmax/@ymax (exclusive)
+void ablitlmt(uint32_t *dst, uint32_t *src, int dx, int dy,
+              int sw, int sh, size_t dstride, size_t sstride,
+              int xmin, int ymin, int xmax, int ymax);
+
+// Same as ablitlmt(), but for span-encoded images: Transparent runs are
+// skipped, opaque runs are copied, and only the rest is blended
+void sblitlmt(uint32_t *dst, const SpanImage *src, int dx, int dy,
+              size_t dstride, int xmin, int ymin, int xmax, int ymax);
+
+// Same as ablitlmt(), but for indexed-color images, which are expanded
+// through their color table while blending
+void iblitlmt(uint32_t *dst, const IndexedImage *src, int dx, int dy,
+              size_t dstride, int xmin, int ymin, int xmax, int ymax);
+
+#endif
@@ -1,12 +1,43 @@
 #ifndef _CPU_H
 #define _CPU_H
 
+#include <stdbool.h>
 #include <stddef.h>
 
 
 typedef size_t base_int_t;
 
 
+enum CSRIndex {
+    CSR_MSTATUS = 0x300,
+    CSR_MISA    = 0x301,
+    CSR_MIE     = 0x304,
+    CSR_MTVEC   = 0x305,
+    CSR_MEPC    = 0x341,
+    CSR_MCAUSE  = 0x342,
+    CSR_MTVAL   = 0x343,
+};
+
+enum MStatusBits {
+    MSTATUS_MIE         = (1ul << 3),
+    MSTATUS_VS_INITIAL  = (1ul << 9),
+    MSTATUS_VS_MASK     = (3ul << 9),
+};
+
+enum MIEBits {
+    MIE_MSIE            = (1ul << 3),
+    MIE_MTIE            = (1ul << 7),
+    MIE_MEIE            = (1ul << 11),
+};
+
+// mcause's lower bits if its top bit (interrupt) is set
+enum InterruptCause {
+    IRQ_M_SOFTWARE      = 3,
+    IRQ_M_TIMER         = 7,
+    IRQ_M_EXTERNAL      = 11,
+};
+
+
 static inline base_int_t read_csr(unsigned index)
 {
     base_int_t result;
@@ -14,4 +45,24 @@ static inline base_int_t read_csr(unsigned index)
     return result;
 }
 
+static inline void set_csr_bits(unsigned index, base_int_t bits)
+{
+    __asm__ __volatile__ ("csrs %0, %1" :: "i"(index), "r"(bits));
+}
+
+static inline void clear_csr_bits(unsigned index, base_int_t bits)
+{
+    __asm__ __volatile__ ("csrc %0, %1" :: "i"(index), "r"(bits));
+}
+
+static inline void write_csr(unsigned index, base_int_t value)
+{
+    __asm__ __volatile__ ("csrw %0, %1" :: "i"(index), "r"(value));
+}
+
+static inline bool cpu_has_extension(char ext)
+{
+    return read_csr(CSR_MISA) & (1ul << (ext - 'A'));
+}
+
 #endif
@@ -0,0 +1,30 @@
+#ifndef _DAMAGE_H
+#define _DAMAGE_H
+
+#include <stdbool.h>
+
+
+#define DAMAGE_MAX_RECTS 8
+
+// Fixed cost of handling one more rectangle (compositing setup plus
+// another transfer/flush pair), in pixels.  Two rectangles are merged
+// if their bounding box wastes fewer pixels than this.
+#define DAMAGE_RECT_COST 4096
+
+// @xmin/@ymin inclusive, @xmax/@ymax exclusive
+typedef struct DamageRect {
+    int xmin, ymin, xmax, ymax;
+} DamageRect;
+
+// A small set of disjoint rectangles
+typedef struct DamageList {
+    int width, height;
+    int count;
+    DamageRect rects[DAMAGE_MAX_RECTS];
+} DamageList;
+
+
+void damage_init(DamageList *dl, int width, int height);
+void damage_add(DamageList *dl, int xmin, int ymin, int xmax, int ymax);
+
+#endif
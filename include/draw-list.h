@@ -0,0 +1,79 @@
+#ifndef _DRAW_LIST_H
+#define _DRAW_LIST_H
+
+#include <damage.h>
+#include <image.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+#define DRAW_LIST_MAX_OPS 32
+
+// Smaller damaged areas are not worth waking other harts for
+#define DRAW_LIST_PARALLEL_MIN_PIXELS (256 * 256)
+
+typedef enum DrawOpType {
+    DRAW_COPY,  // Opaque copy from a framebuffer-sized image
+    DRAW_SPAN,  // SpanImage
+    DRAW_BLEND, // Alpha-blended BGRA image
+} DrawOpType;
+
+typedef struct DrawOp {
+    DrawOpType type;
+
+    // Ops are executed by ascending layer, then in recording order
+    int layer;
+    int seq;
+
+    // What the op draws to, already clipped
+    DamageRect rect;
+
+    // Position of the image's origin (DRAW_SPAN and DRAW_BLEND)
+    int x, y;
+    // DRAW_BLEND image size
+    int w, h;
+    size_t stride;
+
+    const uint32_t *img;
+    const SpanImage *span_img;
+} DrawOp;
+
+// The draw operations and damaged areas of one frame.  Nothing is drawn
+// until draw_list_execute(), which redraws just the damaged areas.
+typedef struct DrawList {
+    int width, height;
+
+    // Applies to all ops recorded from now on
+    DamageRect clip;
+
+    int op_count;
+    DrawOp ops[DRAW_LIST_MAX_OPS];
+
+    DamageList damage;
+} DrawList;
+
+
+void draw_list_init(DrawList *dl, int width, int height);
+
+// Limits ops recorded from now on to this rectangle
+void draw_set_clip(DrawList *dl, int xmin, int ymin, int xmax, int ymax);
+
+// Marks an area as needing to be redrawn (and flushed)
+void draw_damage(DrawList *dl, int xmin, int ymin, int xmax, int ymax);
+
+// Copies @src (framebuffer-sized, with @stride) everywhere in the clip
+// rectangle
+void draw_copy(DrawList *dl, int layer, const uint32_t *src, size_t stride);
+// Draws @img with its origin at @x/@y
+void draw_span(DrawList *dl, int layer, const SpanImage *img, int x, int y);
+// Draws the @w x @h image @img with its origin at @x/@y
+void draw_blend(DrawList *dl, int layer, const uint32_t *img, int w, int h,
+                int x, int y);
+
+// Executes all ops in every damaged area, leaving out those that are
+// covered by an opaque op on top, and flushes the damaged areas in one
+// go.  Resets @dl for the next frame.
+void draw_list_execute(DrawList *dl, uint32_t *fb, size_t stride);
+
+#endif
@@ -12,4 +12,8 @@ void font_draw_text(uint32_t *output, int owidth, int oheight, size_t ostride,
 void font_putchar(uint32_t *output, int owidth, int oheight, size_t ostride,
                   int x, int y, uint32_t chr, uint32_t text_color);
 
+// Height of @text when drawn by font_draw_text() with @width pixels
+// left to its right
+int font_text_height(const char *text, int width);
+
 #endif
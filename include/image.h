@@ -2,8 +2,113 @@
 #define _IMAGE_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+
+enum SpanType {
+    SPAN_SKIP,      // Fully transparent, nothing to draw
+    SPAN_OPAQUE,    // Fully opaque, can just be copied
+    SPAN_BLEND,     // Needs blending (premultiplied alpha)
+};
+
+#define SPAN_TYPE_SHIFT 14
+#define SPAN_MAX_LENGTH ((1 << SPAN_TYPE_SHIFT) - 1)
+
+#define SPAN(type, length) ((uint16_t)(((type) << SPAN_TYPE_SHIFT) | (length)))
+#define SPAN_TYPE(span) ((span) >> SPAN_TYPE_SHIFT)
+#define SPAN_LENGTH(span) ((span) & SPAN_MAX_LENGTH)
+
+// An image split into runs of transparent, opaque, and translucent
+// pixels per row.  Only the pixels of opaque and translucent runs are
+// stored (premultiplied), so a mostly transparent sprite is small, too.
+typedef struct SpanImage {
+    int w, h;
+
+    // @h + 1 entries; row y's spans are spans[rows[y].span] up to
+    // spans[rows[y + 1].span], its first pixel is pixels[rows[y].pixel].
+    // Trailing transparent runs are not stored.
+    struct {
+        uint32_t span, pixel;
+    } *rows;
+    uint16_t *spans;
+    uint32_t *pixels;
+} SpanImage;
+
+
+#define INDEXED_MAX_COLORS 256
+
+// An image with at most INDEXED_MAX_COLORS distinct colors, stored as
+// one byte per pixel plus a color table (premultiplied BGRA), so it
+// takes about a quarter of the memory of the 32-bit image
+typedef struct IndexedImage {
+    int w, h;
+
+    int colors;
+    uint32_t lut[INDEXED_MAX_COLORS];
+    // @w bytes per row
+    uint8_t *pixels;
+} IndexedImage;
+
+
+enum ScaleFilter {
+    SCALE_NEAREST,
+    SCALE_BILINEAR,
+};
+
+// Maps a color to m[c][0] * R + m[c][1] * G + m[c][2] * B + m[c][3] for
+// each output channel c (R, G, B).  Entries are 8.8 fixed point, the
+// offset is relative to 255.
+typedef struct ColorMatrix {
+    int16_t m[3][4];
+} ColorMatrix;
+
+#define COLOR_MATRIX_ONE 256
+
+// Initializer for a matrix that maps white to (@r, @g, @b), so gray
+// levels turn into shades of that color
+#define COLOR_MATRIX_TINT(r, g, b) \
+    { .m = { \
+        { ((r) * COLOR_MATRIX_ONE + 127) / 255, 0, 0, 0 }, \
+        { 0, ((g) * COLOR_MATRIX_ONE + 127) / 255, 0, 0 }, \
+        { 0, 0, ((b) * COLOR_MATRIX_ONE + 127) / 255, 0 }, \
+    } }
+
+
 bool load_image(const char *name, uint32_t **dest, int *w, int *h, int stride);
 
+// Sets the factor by which load_scaled_image() scales images if it is
+// not given a size
+void image_set_scale(int to_w, int from_w, int to_h, int from_h);
+
+// Like load_image(), but the image is scaled to @w x @h instead of
+// having to be that size.  If @w or @h is 0, the image's own size
+// times the factor from image_set_scale() is used (and returned).
+bool load_scaled_image(const char *name, uint32_t **dest, int *w, int *h,
+                       int stride, enum ScaleFilter filter);
+
+// Scales @src to @dst with 16.16 fixed-point sampling positions
+void scale_image(const uint32_t *src, int sw, int sh, size_t sstride,
+                 uint32_t *dst, int dw, int dh, size_t dstride,
+                 enum ScaleFilter filter);
+
+// Applies @m to every pixel of @img in place; alpha is kept
+void tint_image(uint32_t *img, int w, int h, size_t stride,
+                const ColorMatrix *m);
+
+// Like load_scaled_image() (with SCALE_NEAREST), but converts the image
+// into a SpanImage
+bool load_span_image(const char *name, SpanImage *dest, int *w, int *h);
+// Fails (leaving @dest empty) if there is not enough memory
+bool span_encode_image(const uint32_t *img, int w, int h, SpanImage *dest);
+void free_span_image(SpanImage *img);
+
+// Like load_span_image(), but converts the image into an IndexedImage;
+// fails if it has too many colors for that (or there is not enough
+// memory)
+bool load_indexed_image(const char *name, IndexedImage *dest, int *w, int *h);
+bool index_image(const uint32_t *img, int w, int h, size_t stride,
+                 IndexedImage *dest);
+void free_indexed_image(IndexedImage *img);
+
 #endif
@@ -6,8 +6,15 @@
 
 enum VirtPlatformBaseAddresses {
     VPBA_SIFIVE_CLINT   = 0x02000000ul,
+    VPBA_PLIC           = 0x0c000000ul,
     VPBA_UART_BASE      = 0x10000000ul,
     VPBA_VIRTIO_BASE    = 0x10001000ul,
+    VPBA_FW_CFG         = 0x10100000ul,
+};
+
+// PLIC interrupt sources; virtio device n uses VIRT_IRQ_VIRTIO + n
+enum VirtPlatformIRQs {
+    VIRT_IRQ_VIRTIO     = 1,
 };
 
 
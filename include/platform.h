@@ -12,19 +12,54 @@ typedef enum PlatformType {
 } PlatformType;
 
 
+typedef struct FBRect {
+    int x, y, w, h;
+} FBRect;
+
+
 typedef struct PlatformFuncs {
     void (*putchar)(uint8_t c);
 
     uint64_t (*elapsed_us)(void);
+    // Optional: Raises a timer interrupt once elapsed_us() reaches @us
+    void (*set_timer)(uint64_t us);
+
+    // Optional: Raise/acknowledge a software interrupt on @hart (to
+    // wake it from wfi)
+    void (*send_ipi)(int hart);
+    void (*clear_ipi)(int hart);
+
+    // Optional: Has @handler(@opaque) called from the trap handler
+    // whenever interrupt source @irq is raised.  Handlers run with
+    // interrupts disabled and must be quick.
+    bool (*register_irq)(int irq, void (*handler)(void *opaque),
+                         void *opaque);
+    // Dispatches pending external interrupts; called by the trap handler
+    void (*handle_external_irq)(void);
 
     uint32_t *(*framebuffer)(void);
     int (*fb_width)(void);
     int (*fb_height)(void);
     size_t (*fb_stride)(void);
     void (*fb_flush)(int x, int y, int w, int h);
+    // Optional: Flushes all rectangles with as few device round trips
+    // as possible.  Use fb_flush_rects() to fall back to .fb_flush().
+    void (*fb_flush_rects)(const FBRect *rects, int count);
+
+    // Optional double buffering.  The first call to .fb_back_buffer()
+    // switches it on; from then on, everything must be drawn into the
+    // buffer it returns, and flushing only marks areas as changed.
+    // .fb_present() shows them and flips buffers, so .fb_back_buffer()
+    // must be queried again after each call.
+    uint32_t *(*fb_back_buffer)(void);
+    void (*fb_present)(void);
 
     bool (*setup_cursor)(uint32_t *data, int w, int h, int hot_x, int hot_y);
+    // May only record the position until .commit_cursor() is called
     void (*move_cursor)(int x, int y);
+    // Optional: Sends the last position given to .move_cursor(); called
+    // once per frame, must not block
+    void (*commit_cursor)(void);
 
     bool (*need_cursor_updates)(void);
 
@@ -54,4 +89,6 @@ extern PlatformFuncs platform_funcs;
 
 void init_platform(void);
 
+void fb_flush_rects(const FBRect *rects, int count);
+
 #endif
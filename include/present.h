@@ -0,0 +1,25 @@
+#ifndef _PRESENT_H
+#define _PRESENT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+#define PRESENT_RATE_HZ 60
+
+
+// Wraps the platform's flush functions so that flushing only collects
+// damage, which is then submitted to the display at most once per frame
+// by present_frame().  .fb_present() is replaced by a function that
+// submits right away (for when that is really needed, e.g. abort()).
+// Must come before anything else that wraps the flush functions.
+void init_present(int rate_hz);
+
+// Submits everything flushed since the last frame, but only once the
+// next frame is due.  Returns whether it was.
+bool present_frame(void);
+
+// When the next frame is due (in elapsed_us() time)
+uint64_t present_next_deadline(void);
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef _RAMFB_H
+#define _RAMFB_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+// Sets up QEMU's ramfb display through the fw_cfg device at @fw_cfg_base
+// (if there is one), which scans out guest memory directly
+bool init_ramfb(uintptr_t fw_cfg_base);
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef _REGION_GRID_H
+#define _REGION_GRID_H
+
+#include <regions.h>
+
+
+// Edge length of a grid cell, in pixels
+#define REGION_GRID_CELL 128
+
+// Sorts all regions into a grid of cells over a @width x @height area,
+// assuming every region's sprites extend at most @extent_w x @extent_h
+// pixels around its troops_pos (centered)
+void region_grid_init(int width, int height, int extent_w, int extent_h);
+
+// Stores the IDs of all regions whose sprites may overlap the given
+// rectangle in @out (in ascending order) and returns how many there
+// are.  @out must have room for REGION_COUNT entries.
+int region_grid_query(int xmin, int ymin, int xmax, int ymax, RegionID *out);
+
+#endif
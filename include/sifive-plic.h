@@ -0,0 +1,12 @@
+#ifndef _SIFIVE_PLIC_H
+#define _SIFIVE_PLIC_H
+
+#include <stdint.h>
+
+
+// Highest interrupt source number we handle, plus one
+#define PLIC_MAX_IRQS 64
+
+void init_sifive_plic(uintptr_t base);
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef _SMP_H
+#define _SMP_H
+
+#include <stdbool.h>
+
+
+// Must match init.S (which also has every hart's stack)
+#define SMP_MAX_HARTS 8
+
+
+// @index is 0 for the calling hart, up to @count - 1
+typedef void (*SMPJobFunc)(void *arg, int index, int count);
+
+// Runs @func on every hart that is available (including the calling
+// one, which must be the boot hart) and returns once all are done.
+// @func must not call anything that is not reentrant (e.g. malloc).
+void smp_run(SMPJobFunc func, void *arg);
+
+// How many harts smp_run() would currently use
+int smp_hart_count(void);
+
+// Entry point for all harts but the boot hart, called from init.S
+void secondary_hart_main(int hartid) __attribute__((noreturn));
+
+#endif
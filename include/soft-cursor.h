@@ -0,0 +1,9 @@
+#ifndef _SOFT_CURSOR_H
+#define _SOFT_CURSOR_H
+
+// Installs a cursor that is drawn into the framebuffer (with the
+// pixels below it saved so it can be taken away again) as the
+// platform's cursor functions.  For displays without a cursor plane.
+void init_soft_cursor(void);
+
+#endif
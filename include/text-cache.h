@@ -0,0 +1,21 @@
+#ifndef _TEXT_CACHE_H
+#define _TEXT_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+typedef struct TextCacheStats {
+    uint64_t hits, misses, evictions;
+} TextCacheStats;
+
+
+// Same as font_draw_text(), but keeps the rendered text around as a
+// sprite (keyed by text, color, and available width) so drawing the
+// same string again is just a blit
+void text_cache_draw(uint32_t *output, int owidth, int oheight, size_t ostride,
+                     int x, int y, const char *text, uint32_t text_color);
+
+void text_cache_get_stats(TextCacheStats *stats);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef _TRAP_H
+#define _TRAP_H
+
+#include <stdint.h>
+
+
+// Installs the trap handler and enables interrupts on this hart.
+// Exceptions print the faulting state and abort; timer and external
+// interrupts are dispatched to the platform.
+void init_trap(void);
+
+// Only installs the trap handler, for secondary harts: They do not take
+// interrupts, but exceptions in their jobs should be reported, too
+void init_trap_secondary(void);
+
+// Number of interrupts handled so far
+unsigned interrupt_count(void);
+
+// Sleeps until an interrupt arrives, unless one has already been
+// handled since interrupt_count() returned @seen.  Whoever calls this
+// must know that an interrupt is going to come.
+void wait_for_interrupt(unsigned seen);
+
+// Sleeps until elapsed_us() reaches @us or an interrupt arrives.
+// Returns right away without a timer to wake us up.
+void idle_until(uint64_t us);
+
+#endif
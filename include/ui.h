@@ -0,0 +1,83 @@
+#ifndef _UI_H
+#define _UI_H
+
+#include <damage.h>
+#include <image.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+#define UI_MAX_WIDGETS 8
+#define UI_MAX_TEXT 256
+
+typedef enum WidgetType {
+    WIDGET_IMAGE,   // An indexed-color image at the widget's origin
+    WIDGET_TEXT,    // Text, optionally with an icon to its left
+    WIDGET_CUSTOM,  // Drawn by a callback
+} WidgetType;
+
+typedef struct Widget Widget;
+
+// Draws @w's content into @fb; the area has already been cleared
+typedef void (*WidgetDrawFunc)(const Widget *w, uint32_t *fb, size_t stride);
+
+struct Widget {
+    WidgetType type;
+    int x, y, w, h;
+
+    // Needs to be redrawn on the next ui_render()
+    bool dirty;
+
+    // WIDGET_IMAGE (if not NULL)
+    const IndexedImage *image;
+
+    // WIDGET_TEXT (nothing is drawn if the text is empty)
+    char text[UI_MAX_TEXT];
+    uint32_t color;
+    const uint32_t *icon;
+    int icon_w, icon_h;
+
+    // WIDGET_CUSTOM
+    WidgetDrawFunc draw;
+};
+
+// Root of a widget tree: A rectangle with a background, the widgets in
+// it, and an optional overlay on top of everything
+typedef struct WidgetTree {
+    int x, y, w, h;
+
+    // Everything needs to be redrawn, including the background
+    // between widgets
+    bool dirty;
+
+    // @bg is framebuffer-sized with the framebuffer's stride, @overlay
+    // is framebuffer-sized and tightly packed
+    const uint32_t *bg, *overlay;
+    int fb_width, fb_height;
+
+    int widget_count;
+    Widget *widgets[UI_MAX_WIDGETS];
+} WidgetTree;
+
+
+void ui_init(WidgetTree *tree, int x, int y, int w, int h,
+             const uint32_t *bg, int fb_width, int fb_height);
+// Adds @widget as a band across the whole width of @tree
+void ui_add_widget(WidgetTree *tree, Widget *widget, WidgetType type,
+                   int y, int h);
+
+// The setters only mark a widget dirty if its content actually changes
+void ui_set_image(Widget *w, const IndexedImage *image);
+void ui_set_text(Widget *w, const char *text, uint32_t color);
+void ui_set_icon(Widget *w, const uint32_t *icon, int icon_w, int icon_h);
+void ui_set_overlay(WidgetTree *tree, const uint32_t *overlay);
+
+void ui_invalidate(Widget *w);
+
+// Redraws everything dirty into @fb and adds the redrawn areas to
+// @damage, so they can be flushed together with everything else
+void ui_render(WidgetTree *tree, uint32_t *fb, size_t stride,
+               DamageList *damage);
+
+#endif
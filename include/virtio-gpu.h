@@ -84,6 +84,12 @@ struct VirtIOGPUCursorPos {
     uint32_t padding;
 } __attribute__((packed));
 
+enum VirtIOGPUCtrlFlags {
+    // The device sets this (and echoes fence_id) in the response once
+    // the command has been fully executed
+    VIRTIO_GPU_FLAG_FENCE = (1 << 0),
+};
+
 struct VirtIOGPUCtrlHdr {
     uint32_t type;
     uint32_t flags;
@@ -110,7 +116,9 @@ struct VirtIOGPUResourceAttachBacking {
     struct VirtIOGPUCtrlHdr hdr;
     uint32_t resource_id;
     uint32_t nr_entries;
-    struct VirtIOGPUMemEntry entries[];
+    // Really variable-length, but we only ever attach one contiguous
+    // area (and this way, the command fits into a command slot)
+    struct VirtIOGPUMemEntry entries[1];
 } __attribute__((packed));
 
 struct VirtIOGPUSetScanout {
@@ -85,13 +85,12 @@ enum VirtIODeviceStatus {
     DEV_STATUS_FAILED               = 128,
 };
 
-enum VirtIOFeatureFlags {
-    FF_NOTIFY_ON_EMPTY      = (1ull << 24),
-    FF_ANY_LAYOUT           = (1ull << 27),
-    FF_RING_INDIRECT_LAYOUT = (1ull << 28),
-    FF_RING_EVENT_IDX       = (1ull << 29),
-    FF_VERSION_1            = (1ull << 30),
-};
+// Feature bits go up to 63, which an enum cannot hold
+#define FF_NOTIFY_ON_EMPTY      (1ull << 24)
+#define FF_ANY_LAYOUT           (1ull << 27)
+#define FF_RING_INDIRECT_LAYOUT (1ull << 28)
+#define FF_RING_EVENT_IDX       (1ull << 29)
+#define FF_VERSION_1            (1ull << 32)
 
 enum VirtQDescFlags {
     VQDF_NEXT       = (1 << 0),
@@ -137,31 +136,91 @@ struct VirtQDesc {
 #define ROUND_UP(x, y) (((x) + (y) - 1) & -(y))
 #endif
 
-#define VirtQTotalSize(QUEUE_SIZE) \
-    (ROUND_UP(sizeof(struct VirtQDesc) * QUEUE_SIZE + \
-              sizeof(VirtQAvail(QUEUE_SIZE)), PAGESIZE) + \
-     ROUND_UP(sizeof(VirtQUsed(QUEUE_SIZE)), PAGESIZE))
+typedef struct VirtQ VirtQ;
+
+typedef struct VirtIOStats {
+    // Every notification is a write to queue_notify, i.e. a VM exit
+    uint64_t notifications, suppressed_notifications;
+} VirtIOStats;
+
+// Called from the interrupt handler when @vq has new used buffers
+typedef void (*VirtQCallback)(VirtQ *vq);
 
-typedef struct VirtQ {
-    void *base; // Point to something of VirtQTotalSize(queue_size)
+struct VirtQ {
+    // Allocated by vq_init(); @base is the descriptor table, @avail
+    // points to a VirtQAvail(queue_size), @used to a VirtQUsed(queue_size)
+    void *base, *avail, *used;
     int queue_index;
     int queue_size;
     uint16_t desc_i, avail_i, used_i;
     volatile struct VirtIOControlRegs *regs;
-} VirtQ;
 
+    // VIRTIO_F_EVENT_IDX has been negotiated: The device only wants to
+    // be notified (and only interrupts us) at the entries the other
+    // side asks for.  @kicked_i is avail_i as of the last vq_exec().
+    bool event_idx;
+    uint16_t kicked_i;
 
-void init_virtio_device(struct VirtIOControlRegs *regs);
+    // VIRTIO_F_INDIRECT_DESC has been negotiated, so vq_push_indirect()
+    // takes up only one descriptor per chain
+    bool indirect;
+
+    // Set by vq_enable_interrupts(); waiting for the device then
+    // sleeps instead of spinning
+    bool interrupts;
+    VirtQCallback callback;
+};
 
-int virtio_basic_negotiate(struct VirtIOControlRegs *regs, uint64_t *features);
 
-bool vq_init(VirtQ *vq, int queue_index, void *base, int queue_size,
+// Most devices a platform can have, and most virtqueues per device that
+// can have interrupts enabled
+#define VIRTIO_MAX_DEVICES 8
+#define VIRTIO_MAX_IRQ_QUEUES 2
+
+// @irq is the device's interrupt source, or 0 if it has none
+void init_virtio_device(struct VirtIOControlRegs *regs, int irq);
+
+int virtio_basic_negotiate(struct VirtIOControlRegs *regs, uint64_t *features);
+// Call once all virtqueues are set up, before submitting anything
+void virtio_driver_ok(struct VirtIOControlRegs *regs);
+
+// Reading the device-specific config space is only consistent if this
+// does not change in the meantime:
+//   do {
+//       gen = virtio_config_generation(regs);
+//       ...
+//   } while (gen != virtio_config_generation(regs));
+uint32_t virtio_config_generation(volatile struct VirtIOControlRegs *regs);
+
+// Allocates the rings and hands them to the device
+bool vq_init(VirtQ *vq, int queue_index, int queue_size,
              volatile struct VirtIOControlRegs *regs);
 void vq_push_descriptor(VirtQ *vq, void *ptr, size_t length,
                         bool write, bool first, bool last);
+// Fills in entry @i of the @count entries long indirect descriptor
+// table @table, chaining it to the next entry unless it is the last
+void vq_set_indirect(struct VirtQDesc *table, int i, int count,
+                     void *ptr, size_t length, bool write);
+// Queues the descriptor chain in @table as one request, which takes up
+// a single descriptor in the ring.  @table must stay untouched until
+// the device has used it.  Without VIRTIO_F_INDIRECT_DESC, the chain
+// is copied into the ring instead (vq_push_descriptor() for each entry).
+void vq_push_indirect(VirtQ *vq, struct VirtQDesc *table, int count);
 void vq_exec(VirtQ *vq);
 uint16_t vq_wait_used(VirtQ *vq);
 int vq_single_poll_used(VirtQ *vq);
+// The head descriptor of the chain in used element @used_idx (as
+// returned by vq_wait_used() and vq_single_poll_used())
+uint32_t vq_used_id(VirtQ *vq, uint16_t used_idx);
 void vq_wait_settled(VirtQ *vq);
 
+// Has the device interrupt us when it uses buffers in @vq, and calls
+// @callback (may be NULL) from the interrupt handler then.  Call after
+// vq_init().  Returns false (and nothing changes) if there is no
+// interrupt to be had.
+bool vq_enable_interrupts(VirtQ *vq, VirtQCallback callback);
+
+// Totals over all virtqueues
+void virtio_get_stats(VirtIOStats *stats);
+
 #endif
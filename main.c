@@ -1,3 +1,5 @@
+#include <benchmark.h>
+#include <blit.h>
 #include <cpu.h>
 #include <font.h>
 #include <game-logic.h>
@@ -6,10 +8,13 @@
 #include <music.h>
 #include <nonstddef.h>
 #include <platform.h>
+#include <present.h>
+#include <soft-cursor.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <trap.h>
 
 
 #define PRINT(...) \
@@ -25,11 +30,13 @@ extern uint32_t *abort_image;
 
 void main(void)
 {
+    // Devices may already wait for interrupts while being initialized
+    init_trap();
     init_platform();
 
     PRINT("Hello, RISC-V world!\n");
 
-    base_int_t misa = read_csr(0x301);
+    base_int_t misa = read_csr(CSR_MISA);
     int mxl = misa >> (sizeof(base_int_t) * 8 - 2);
 
     PRINT("CPU model: RV%i", 16 << mxl);
@@ -40,6 +47,8 @@ void main(void)
     }
     putchar('\n');
 
+    init_blit();
+
 
     // Quick initialization to get a loading screen up
 
@@ -55,13 +64,17 @@ void main(void)
     int fbh = platform_funcs.fb_height();
     size_t fb_stride = platform_funcs.fb_stride();
 
-    if (!load_image("/abort.png", &abort_image, &fbw, &fbh, fb_stride)) {
+    if (!load_scaled_image("/abort.png", &abort_image, &fbw, &fbh, fb_stride,
+                           SCALE_BILINEAR))
+    {
         PRINT("Failed to load abort screen\n");
         abort();
     }
 
     uint32_t *loading_image = NULL;
-    if (!load_image("/loading.png", &loading_image, &fbw, &fbh, fb_stride)) {
+    if (!load_scaled_image("/loading.png", &loading_image, &fbw, &fbh,
+                           fb_stride, SCALE_BILINEAR))
+    {
         PRINT("Failed to load loading screen\n"); // how ironic
         abort();
     }
@@ -73,6 +86,10 @@ void main(void)
 
     // Now initialize the rest
 
+    // Before the software cursor, which has to see every flush as it
+    // happens
+    init_present(PRESENT_RATE_HZ);
+
     {
         uint32_t *cursor = NULL;
         int cursor_w = 0, cursor_h = 0;
@@ -81,6 +98,10 @@ void main(void)
             abort();
         }
 
+        if (!platform_funcs.setup_cursor) {
+            init_soft_cursor();
+        }
+
         // FIXME: hot_x/hot_y
         if (!platform_funcs.setup_cursor(cursor, cursor_w, cursor_h, 2, 4)) {
             PRINT("Failed to setup the cursor\n");
@@ -92,13 +113,24 @@ void main(void)
 
 
     init_font();
+
+    run_benchmarks();
+
     init_game();
     init_music();
 
 
     for (;;) {
         handle_game();
+        if (platform_funcs.commit_cursor) {
+            platform_funcs.commit_cursor();
+        }
+        present_frame();
         handle_music();
         platform_funcs.handle_audio();
+
+        // Input and the next frame are what there is to wait for (the
+        // audio buffer lasts longer than a frame)
+        idle_until(present_next_deadline());
     }
 }
@@ -1,6 +1,8 @@
 #include <platform.h>
 #include <platform-virt.h>
+#include <ramfb.h>
 #include <sifive-clint.h>
+#include <sifive-plic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -28,18 +30,26 @@ bool init_platform_virt(void)
     puts("[platform-virt] Virt platform detected");
 
     init_sifive_clint(VPBA_SIFIVE_CLINT);
+    // Before the virtio devices, which register their interrupts
+    init_sifive_plic(VPBA_PLIC);
 
     /*
      * TODO: Instead of artificially limiting the number of devices
      *       here, maybe catch faults instead.
      */
-    while (virtio_control - virtio_base < 8 &&
+    while (virtio_control - virtio_base < VIRTIO_MAX_DEVICES &&
            virtio_control->magic == STR_TO_U32("virt"))
     {
-        init_virtio_device(virtio_control);
+        init_virtio_device(virtio_control,
+                           VIRT_IRQ_VIRTIO + (virtio_control - virtio_base));
         virtio_control++;
     }
 
+    // Fall back to ramfb if there is no virtio-gpu
+    if (!platform_funcs.framebuffer) {
+        init_ramfb(VPBA_FW_CFG);
+    }
+
     init_virt_sound();
 
     return true;
@@ -22,3 +22,17 @@ void init_platform(void)
 
     assert(0);
 }
+
+
+void fb_flush_rects(const FBRect *rects, int count)
+{
+    if (platform_funcs.fb_flush_rects) {
+        platform_funcs.fb_flush_rects(rects, count);
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        platform_funcs.fb_flush(rects[i].x, rects[i].y,
+                                rects[i].w, rects[i].h);
+    }
+}
@@ -0,0 +1,153 @@
+#include <assert.h>
+#include <damage.h>
+#include <nonstddef.h>
+#include <platform.h>
+#include <present.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+
+#define PRESENT_REPORT_INTERVAL_US 1000000
+
+
+// Flushed since the last submission
+static DamageList pending;
+
+static uint64_t frame_us, next_deadline;
+
+// Pacing only starts with the first present_frame(), so that all of
+// the initialization after init_present() does not count as missed
+static bool started;
+
+// Statistics since the last report
+static uint64_t next_report;
+static int frames, missed;
+static uint64_t worst_late_us;
+
+// The display's own functions, which ours wrap
+static void (*display_flush)(int x, int y, int w, int h);
+static void (*display_flush_rects)(const FBRect *rects, int count);
+static void (*display_present)(void);
+
+
+static void flush(int x, int y, int w, int h)
+{
+    int fbw = platform_funcs.fb_width();
+    int fbh = platform_funcs.fb_height();
+
+    damage_add(&pending, x, y, w > 0 ? x + w : fbw, h > 0 ? y + h : fbh);
+}
+
+
+static void flush_rects(const FBRect *rects, int count)
+{
+    for (int i = 0; i < count; i++) {
+        flush(rects[i].x, rects[i].y, rects[i].w, rects[i].h);
+    }
+}
+
+
+static void submit(void)
+{
+    if (!pending.count) {
+        return;
+    }
+
+    FBRect rects[DAMAGE_MAX_RECTS];
+    for (int i = 0; i < pending.count; i++) {
+        rects[i] = (FBRect){
+            .x = pending.rects[i].xmin,
+            .y = pending.rects[i].ymin,
+            .w = pending.rects[i].xmax - pending.rects[i].xmin,
+            .h = pending.rects[i].ymax - pending.rects[i].ymin,
+        };
+    }
+
+    if (display_flush_rects) {
+        display_flush_rects(rects, pending.count);
+    } else {
+        for (int i = 0; i < pending.count; i++) {
+            display_flush(rects[i].x, rects[i].y, rects[i].w, rects[i].h);
+        }
+    }
+
+    if (display_present) {
+        display_present();
+    }
+
+    damage_init(&pending, platform_funcs.fb_width(),
+                platform_funcs.fb_height());
+}
+
+
+bool present_frame(void)
+{
+    uint64_t now = platform_funcs.elapsed_us();
+
+    if (!started) {
+        started = true;
+        next_deadline = now;
+        next_report = now + PRESENT_REPORT_INTERVAL_US;
+    }
+
+    if (now < next_deadline) {
+        return false;
+    }
+
+    submit();
+    frames++;
+
+    // Only late enough to have skipped a whole frame counts as missed;
+    // in that case, the next deadline is the first one still ahead
+    uint64_t late = now - next_deadline;
+    uint64_t skipped = late / frame_us;
+    if (skipped) {
+        missed += (int)skipped;
+        worst_late_us = MAX(worst_late_us, late);
+    }
+    next_deadline += (skipped + 1) * frame_us;
+
+    if (now >= next_report) {
+        if (missed) {
+            printf("[present] Missed %i of %i frame deadlines, "
+                   "up to %zu us late\n",
+                   missed, frames + missed, (size_t)worst_late_us);
+        }
+
+        frames = 0;
+        missed = 0;
+        worst_late_us = 0;
+        next_report = now + PRESENT_REPORT_INTERVAL_US;
+    }
+
+    return true;
+}
+
+
+uint64_t present_next_deadline(void)
+{
+    return next_deadline;
+}
+
+
+void init_present(int rate_hz)
+{
+    assert(platform_funcs.fb_flush && rate_hz > 0);
+
+    display_flush = platform_funcs.fb_flush;
+    display_flush_rects = platform_funcs.fb_flush_rects;
+    display_present = platform_funcs.fb_present;
+
+    platform_funcs.fb_flush = flush;
+    platform_funcs.fb_flush_rects = flush_rects;
+    platform_funcs.fb_present = submit;
+
+    damage_init(&pending, platform_funcs.fb_width(),
+                platform_funcs.fb_height());
+
+    frame_us = 1000000 / rate_hz;
+
+    printf("[present] Presenting at %i Hz\n", rate_hz);
+}
@@ -0,0 +1,250 @@
+#include <config.h>
+#include <platform.h>
+#include <ramfb.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+// ramfb has no way to tell us about the display, so we choose; this is
+// the size all assets are drawn for
+#define RAMFB_WIDTH 1600
+#define RAMFB_HEIGHT 900
+
+// DRM_FORMAT_XRGB8888, i.e. BGRX in memory
+#define RAMFB_FOURCC 0x34325258
+
+// fw_cfg MMIO registers (all big-endian)
+#define FW_CFG_REG_SELECTOR 0x08
+#define FW_CFG_REG_DMA_HI   0x10
+#define FW_CFG_REG_DMA_LO   0x14
+
+#define FW_CFG_SIGNATURE 0x00
+#define FW_CFG_ID        0x01
+#define FW_CFG_FILE_DIR  0x19
+
+#define FW_CFG_ID_DMA (1 << 1)
+
+enum FWCfgDmaControl {
+    FW_CFG_DMA_ERROR    = (1 << 0),
+    FW_CFG_DMA_READ     = (1 << 1),
+    FW_CFG_DMA_SKIP     = (1 << 2),
+    FW_CFG_DMA_SELECT   = (1 << 3),
+    FW_CFG_DMA_WRITE    = (1 << 4),
+};
+
+struct FWCfgDmaAccess {
+    uint32_t control;
+    uint32_t length;
+    uint64_t address;
+} __attribute__((packed, aligned(16)));
+
+struct FWCfgFile {
+    uint32_t size;
+    uint16_t select;
+    uint16_t reserved;
+    char name[56];
+} __attribute__((packed));
+
+struct RAMFBCfg {
+    uint64_t addr;
+    uint32_t fourcc;
+    uint32_t flags;
+    uint32_t width, height;
+    uint32_t stride;
+} __attribute__((packed));
+
+
+static volatile uint8_t *fw_cfg;
+
+static uint32_t *framebuffer;
+static size_t fb_stride;
+
+
+static uint16_t be16(uint16_t x)
+{
+    return __builtin_bswap16(x);
+}
+
+static uint32_t be32(uint32_t x)
+{
+    return __builtin_bswap32(x);
+}
+
+static uint64_t be64(uint64_t x)
+{
+    return __builtin_bswap64(x);
+}
+
+
+// Reads @length bytes from @key through the data port, one at a time
+static void fw_cfg_read(int key, void *buffer, size_t length)
+{
+    *(volatile uint16_t *)(fw_cfg + FW_CFG_REG_SELECTOR) = be16(key);
+
+    for (size_t i = 0; i < length; i++) {
+        ((uint8_t *)buffer)[i] = *fw_cfg;
+    }
+}
+
+
+// Selects @key (unless negative), then reads or writes @length bytes
+// from/to @buffer
+static bool fw_cfg_dma(int key, uint32_t control, void *buffer,
+                       uint32_t length)
+{
+    static struct FWCfgDmaAccess access;
+
+    if (key >= 0) {
+        control |= FW_CFG_DMA_SELECT | ((uint32_t)key << 16);
+    }
+
+    access = (struct FWCfgDmaAccess){
+        .control = be32(control),
+        .length = be32(length),
+        .address = be64((uintptr_t)buffer),
+    };
+
+    __sync_synchronize();
+
+    // Writing the low half starts the transfer
+    uint64_t addr = (uintptr_t)&access;
+    *(volatile uint32_t *)(fw_cfg + FW_CFG_REG_DMA_HI) = be32(addr >> 32);
+    *(volatile uint32_t *)(fw_cfg + FW_CFG_REG_DMA_LO) = be32(addr);
+
+    // QEMU completes the transfer before the write returns, but do not
+    // rely on it
+    uint32_t status;
+    while ((status = be32(*(volatile uint32_t *)&access.control)) &
+           ~FW_CFG_DMA_ERROR)
+    {
+        __asm__ __volatile__ ("" ::: "memory");
+    }
+
+    __sync_synchronize();
+
+    return !(status & FW_CFG_DMA_ERROR);
+}
+
+
+static int find_file(const char *name)
+{
+    uint32_t count;
+    if (!fw_cfg_dma(FW_CFG_FILE_DIR, FW_CFG_DMA_READ, &count, sizeof(count)))
+    {
+        return -1;
+    }
+
+    count = be32(count);
+    for (uint32_t i = 0; i < count; i++) {
+        struct FWCfgFile file;
+        // Continues where the last read stopped
+        if (!fw_cfg_dma(-1, FW_CFG_DMA_READ, &file, sizeof(file))) {
+            return -1;
+        }
+
+        if (!strncmp(file.name, name, sizeof(file.name))) {
+            return be16(file.select);
+        }
+    }
+
+    return -1;
+}
+
+
+static uint32_t *get_framebuffer(void)
+{
+    return framebuffer;
+}
+
+static int get_framebuffer_width(void)
+{
+    return RAMFB_WIDTH;
+}
+
+static int get_framebuffer_height(void)
+{
+    return RAMFB_HEIGHT;
+}
+
+static size_t get_framebuffer_stride(void)
+{
+    return fb_stride;
+}
+
+
+static void flush_framebuffer(int x, int y, int w, int h)
+{
+    (void)x;
+    (void)y;
+    (void)w;
+    (void)h;
+
+    // The host scans out our memory directly; just make sure what we
+    // wrote is visible to it
+    __sync_synchronize();
+}
+
+
+bool init_ramfb(uintptr_t fw_cfg_base)
+{
+    fw_cfg = (volatile uint8_t *)fw_cfg_base;
+
+    char signature[4];
+    fw_cfg_read(FW_CFG_SIGNATURE, signature, sizeof(signature));
+    if (memcmp(signature, "QEMU", 4)) {
+        return false;
+    }
+
+    // Little-endian, unlike everything else
+    uint8_t id[4];
+    fw_cfg_read(FW_CFG_ID, id, sizeof(id));
+    if (!(id[0] & FW_CFG_ID_DMA)) {
+        puts("[ramfb] fw_cfg has no DMA interface");
+        return false;
+    }
+
+    int ramfb_key = find_file("etc/ramfb");
+    if (ramfb_key < 0) {
+        return false;
+    }
+
+    printf("[ramfb] Found device (fw_cfg key %i)\n", ramfb_key);
+
+    fb_stride = RAMFB_WIDTH * sizeof(uint32_t);
+    framebuffer = memalign(PAGESIZE, RAMFB_HEIGHT * fb_stride);
+    if (!framebuffer) {
+        puts("[ramfb] FATAL: Failed to allocate the framebuffer");
+        return false;
+    }
+    memset(framebuffer, 0, RAMFB_HEIGHT * fb_stride);
+
+    static struct RAMFBCfg cfg;
+    cfg = (struct RAMFBCfg){
+        .addr = be64((uintptr_t)framebuffer),
+        .fourcc = be32(RAMFB_FOURCC),
+        .width = be32(RAMFB_WIDTH),
+        .height = be32(RAMFB_HEIGHT),
+        .stride = be32(fb_stride),
+    };
+
+    if (!fw_cfg_dma(ramfb_key, FW_CFG_DMA_WRITE, &cfg, sizeof(cfg))) {
+        puts("[ramfb] FATAL: Failed to configure the display");
+        free(framebuffer);
+        return false;
+    }
+
+    printf("[ramfb] Framebuffer set up @%p (%ix%i)\n", (void *)framebuffer,
+           RAMFB_WIDTH, RAMFB_HEIGHT);
+
+    platform_funcs.framebuffer = get_framebuffer;
+    platform_funcs.fb_width = get_framebuffer_width;
+    platform_funcs.fb_height = get_framebuffer_height;
+    platform_funcs.fb_stride = get_framebuffer_stride;
+    platform_funcs.fb_flush = flush_framebuffer;
+
+    return true;
+}
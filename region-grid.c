@@ -0,0 +1,111 @@
+#include <assert.h>
+#include <nonstddef.h>
+#include <region-grid.h>
+#include <regions.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+static int cells_x, cells_y;
+
+// The regions in cell i are cell_regions[cell_start[i]] up to
+// cell_regions[cell_start[i + 1]]
+static int *cell_start;
+static RegionID *cell_regions;
+
+// Every region must be reported only once per query, even if it spans
+// several of the cells visited
+static unsigned query_stamp;
+static unsigned region_stamp[REGION_COUNT];
+
+
+// Cell range covered by the given rectangle, clamped to the grid
+static void cell_range(int xmin, int ymin, int xmax, int ymax,
+                       int *cx0, int *cy0, int *cx1, int *cy1)
+{
+    *cx0 = MAX(xmin, 0) / REGION_GRID_CELL;
+    *cy0 = MAX(ymin, 0) / REGION_GRID_CELL;
+    *cx1 = MIN(DIV_ROUND_UP(MAX(xmax, 0), REGION_GRID_CELL), cells_x);
+    *cy1 = MIN(DIV_ROUND_UP(MAX(ymax, 0), REGION_GRID_CELL), cells_y);
+}
+
+
+void region_grid_init(int width, int height, int extent_w, int extent_h)
+{
+    cells_x = DIV_ROUND_UP(width, REGION_GRID_CELL);
+    cells_y = DIV_ROUND_UP(height, REGION_GRID_CELL);
+
+    int cell_count = cells_x * cells_y;
+    cell_start = calloc(cell_count + 1, sizeof(cell_start[0]));
+
+    // Two passes: Count the regions per cell first, then fill them in
+    for (int pass = 0; pass < 2; pass++) {
+        int *fill = NULL;
+        if (pass == 1) {
+            for (int i = 0; i < cell_count; i++) {
+                cell_start[i + 1] += cell_start[i];
+            }
+            cell_regions = malloc(cell_start[cell_count] *
+                                  sizeof(cell_regions[0]));
+            fill = calloc(cell_count, sizeof(fill[0]));
+        }
+
+        for (RegionID r = 1; r < REGION_COUNT; r++) {
+            int x = regions[r].troops_pos.x - extent_w / 2;
+            int y = regions[r].troops_pos.y - extent_h / 2;
+            int cx0, cy0, cx1, cy1;
+            cell_range(x, y, x + extent_w, y + extent_h,
+                       &cx0, &cy0, &cx1, &cy1);
+
+            for (int cy = cy0; cy < cy1; cy++) {
+                for (int cx = cx0; cx < cx1; cx++) {
+                    int cell = cy * cells_x + cx;
+                    if (pass == 0) {
+                        cell_start[cell + 1]++;
+                    } else {
+                        cell_regions[cell_start[cell] + fill[cell]++] = r;
+                    }
+                }
+            }
+        }
+
+        free(fill);
+    }
+}
+
+
+int region_grid_query(int xmin, int ymin, int xmax, int ymax, RegionID *out)
+{
+    assert(cell_start);
+
+    int cx0, cy0, cx1, cy1;
+    cell_range(xmin, ymin, xmax, ymax, &cx0, &cy0, &cx1, &cy1);
+
+    query_stamp++;
+
+    int count = 0;
+    for (int cy = cy0; cy < cy1; cy++) {
+        for (int cx = cx0; cx < cx1; cx++) {
+            int cell = cy * cells_x + cx;
+
+            for (int i = cell_start[cell]; i < cell_start[cell + 1]; i++) {
+                RegionID r = cell_regions[i];
+                if (region_stamp[r] == query_stamp) {
+                    continue;
+                }
+                region_stamp[r] = query_stamp;
+
+                // Insertion sort, so overlapping sprites are still
+                // drawn in the same order as before
+                int j = count++;
+                while (j > 0 && out[j - 1] > r) {
+                    out[j] = out[j - 1];
+                    j--;
+                }
+                out[j] = r;
+            }
+        }
+    }
+
+    return count;
+}
@@ -5,9 +5,16 @@ if [ -z "$QEMU" ]; then
     exit 1
 fi
 
+# RAMFB=1 uses the ramfb display instead of virtio-gpu
+if [ "$RAMFB" = 1 ]; then
+    DISPLAY_DEVICE=ramfb
+else
+    DISPLAY_DEVICE=virtio-gpu-device,xres=1600,yres=900
+fi
+
 $QEMU \
     -kernel kernel -serial stdio -M virt \
-    -device virtio-gpu-device,xres=1600,yres=900 \
+    -device $DISPLAY_DEVICE \
     -device virtio-keyboard-device \
     -device virtio-tablet-device \
     $@ \
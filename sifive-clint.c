@@ -7,6 +7,9 @@
 static uintptr_t base;
 
 static uint64_t elapsed_us(void);
+static void set_timer(uint64_t us);
+static void send_ipi(int hart);
+static void clear_ipi(int hart);
 
 void init_sifive_clint(uintptr_t b)
 {
@@ -20,6 +23,9 @@ void init_sifive_clint(uintptr_t b)
     base = b;
 
     platform_funcs.elapsed_us = elapsed_us;
+    platform_funcs.set_timer = set_timer;
+    platform_funcs.send_ipi = send_ipi;
+    platform_funcs.clear_ipi = clear_ipi;
 }
 
 
@@ -30,3 +36,25 @@ static uint64_t elapsed_us(void)
 
     return (((uint64_t)hi << 32) | lo) / 10;
 }
+
+
+// mtimecmp of hart 0, which is the only one taking timer interrupts
+static void set_timer(uint64_t us)
+{
+    *(volatile uint64_t *)(base + 0x4000) = us * 10;
+}
+
+
+// msip, one word per hart at the start of the CLINT
+static void send_ipi(int hart)
+{
+    __sync_synchronize();
+    *(volatile uint32_t *)(base + hart * 4) = 1;
+}
+
+
+static void clear_ipi(int hart)
+{
+    *(volatile uint32_t *)(base + hart * 4) = 0;
+    __sync_synchronize();
+}
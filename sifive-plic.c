@@ -0,0 +1,82 @@
+#include <platform.h>
+#include <sifive-plic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+
+// We only ever take interrupts on hart 0 in M-mode, which is context 0
+#define PLIC_CONTEXT 0
+
+#define PLIC_PRIORITY(irq)  (base + (irq) * 4)
+#define PLIC_ENABLE(irq)    (base + 0x2000 + PLIC_CONTEXT * 0x80 \
+                             + (irq) / 32 * 4)
+#define PLIC_THRESHOLD      (base + 0x200000 + PLIC_CONTEXT * 0x1000)
+#define PLIC_CLAIM          (base + 0x200004 + PLIC_CONTEXT * 0x1000)
+
+
+static uintptr_t base;
+
+static struct {
+    void (*handler)(void *opaque);
+    void *opaque;
+} handlers[PLIC_MAX_IRQS];
+
+static bool register_irq(int irq, void (*handler)(void *opaque),
+                         void *opaque);
+static void handle_external_irq(void);
+
+void init_sifive_plic(uintptr_t b)
+{
+    if (base) {
+        puts("[sifive-plic] Ignoring second PLIC");
+        return;
+    }
+
+    printf("[sifive-plic] Found PLIC @%p\n", (void *)b);
+
+    base = b;
+
+    // Everything with a priority above 0 gets through
+    *(volatile uint32_t *)PLIC_THRESHOLD = 0;
+
+    platform_funcs.register_irq = register_irq;
+    platform_funcs.handle_external_irq = handle_external_irq;
+}
+
+
+static bool register_irq(int irq, void (*handler)(void *opaque),
+                         void *opaque)
+{
+    // Source 0 does not exist
+    if (irq <= 0 || irq >= PLIC_MAX_IRQS || handlers[irq].handler) {
+        printf("[sifive-plic] Cannot register IRQ %i\n", irq);
+        return false;
+    }
+
+    handlers[irq].handler = handler;
+    handlers[irq].opaque = opaque;
+    __sync_synchronize();
+
+    *(volatile uint32_t *)PLIC_PRIORITY(irq) = 1;
+    *(volatile uint32_t *)PLIC_ENABLE(irq) |= 1u << (irq % 32);
+
+    return true;
+}
+
+
+static void handle_external_irq(void)
+{
+    volatile uint32_t *claim = (volatile uint32_t *)PLIC_CLAIM;
+    uint32_t irq;
+
+    while ((irq = *claim) != 0) {
+        if (irq < PLIC_MAX_IRQS && handlers[irq].handler) {
+            handlers[irq].handler(handlers[irq].opaque);
+        }
+
+        // Complete
+        *claim = irq;
+    }
+}
@@ -0,0 +1,113 @@
+#include <cpu.h>
+#include <platform.h>
+#include <smp.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <trap.h>
+
+
+// Set by every secondary hart once it waits for jobs.  Hart IDs are
+// contiguous, so we use harts 1 up to the first one that is not ready.
+static bool hart_ready[SMP_MAX_HARTS];
+
+static struct {
+    SMPJobFunc func;
+    void *arg;
+    int count;
+} job;
+
+// Incremented for every job, so parked harts know there is a new one
+static unsigned job_generation;
+// Harts other than the boot hart that have not finished the job yet
+static int job_remaining;
+
+
+int smp_hart_count(void)
+{
+    // Without IPIs, parked harts would never wake up
+    if (!platform_funcs.send_ipi) {
+        return 1;
+    }
+
+    int count = 1;
+    while (count < SMP_MAX_HARTS &&
+           __atomic_load_n(&hart_ready[count], __ATOMIC_ACQUIRE))
+    {
+        count++;
+    }
+    return count;
+}
+
+
+void smp_run(SMPJobFunc func, void *arg)
+{
+    int count = smp_hart_count();
+
+    if (count == 1) {
+        func(arg, 0, 1);
+        return;
+    }
+
+    job.func = func;
+    job.arg = arg;
+    job.count = count;
+
+    __atomic_store_n(&job_remaining, count - 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&job_generation, 1, __ATOMIC_RELEASE);
+
+    for (int i = 1; i < count; i++) {
+        platform_funcs.send_ipi(i);
+    }
+
+    func(arg, 0, count);
+
+    // Barrier
+    while (__atomic_load_n(&job_remaining, __ATOMIC_ACQUIRE)) {
+        __asm__ __volatile__ ("" ::: "memory");
+    }
+}
+
+
+void secondary_hart_main(int hartid)
+{
+    init_trap_secondary();
+
+    // Same as the boot hart does in init_blit(), in case we get to run
+    // RVV code
+    if (cpu_has_extension('V')) {
+        set_csr_bits(CSR_MSTATUS, MSTATUS_VS_INITIAL);
+    }
+
+    // Let software interrupts end wfi (they are not taken, because
+    // mstatus.MIE stays clear)
+    set_csr_bits(CSR_MIE, MIE_MSIE);
+
+    unsigned seen = __atomic_load_n(&job_generation, __ATOMIC_ACQUIRE);
+    __atomic_store_n(&hart_ready[hartid], true, __ATOMIC_RELEASE);
+
+    for (;;) {
+        unsigned generation;
+
+        for (;;) {
+            if (platform_funcs.clear_ipi) {
+                platform_funcs.clear_ipi(hartid);
+            }
+
+            generation = __atomic_load_n(&job_generation, __ATOMIC_ACQUIRE);
+            if (generation != seen) {
+                break;
+            }
+
+            __asm__ __volatile__ ("wfi" ::: "memory");
+        }
+
+        seen = generation;
+
+        // We may have become ready after the job was started
+        if (hartid < job.count) {
+            job.func(job.arg, hartid, job.count);
+            __atomic_sub_fetch(&job_remaining, 1, __ATOMIC_RELEASE);
+        }
+    }
+}
@@ -0,0 +1,225 @@
+#include <assert.h>
+#include <blit.h>
+#include <damage.h>
+#include <nonstddef.h>
+#include <platform.h>
+#include <soft-cursor.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+
+#define SOFT_CURSOR_W 64
+#define SOFT_CURSOR_H 64
+
+
+static uint32_t sprite[SOFT_CURSOR_W * SOFT_CURSOR_H];
+static int sprite_w, sprite_h, sprite_hot_x, sprite_hot_y;
+
+// What the framebuffer showed below the cursor at @drawn_rect
+static uint32_t save_under[SOFT_CURSOR_W * SOFT_CURSOR_H];
+static bool drawn;
+static DamageRect drawn_rect;
+
+static int cursor_x, cursor_y;
+static bool moved;
+
+// Per pixel of @drawn_rect, whether it has been flushed (i.e. drawn
+// over) since the last commit_cursor().  Exact, because wherever it is
+// not set, the cursor is still there and has to be taken away.
+static bool overdrawn_mask[SOFT_CURSOR_W * SOFT_CURSOR_H];
+static bool overdrawn;
+
+// The display's own flush functions, which ours wrap
+static void (*display_flush)(int x, int y, int w, int h);
+static void (*display_flush_rects)(const FBRect *rects, int count);
+
+
+static void note_damage(int x, int y, int w, int h)
+{
+    if (!drawn) {
+        return;
+    }
+
+    const DamageRect *r = &drawn_rect;
+    int xmin = MAX(x, r->xmin);
+    int ymin = MAX(y, r->ymin);
+    int xmax = MIN(w > 0 ? x + w : platform_funcs.fb_width(), r->xmax);
+    int ymax = MIN(h > 0 ? y + h : platform_funcs.fb_height(), r->ymax);
+
+    if (xmin >= xmax || ymin >= ymax) {
+        return;
+    }
+
+    for (int my = ymin; my < ymax; my++) {
+        int row = (my - r->ymin) * (r->xmax - r->xmin) - r->xmin;
+        for (int mx = xmin; mx < xmax; mx++) {
+            overdrawn_mask[row + mx] = true;
+        }
+    }
+    overdrawn = true;
+}
+
+
+static void display_flush_list(const FBRect *rects, int count)
+{
+    if (display_flush_rects) {
+        display_flush_rects(rects, count);
+    } else {
+        for (int i = 0; i < count; i++) {
+            display_flush(rects[i].x, rects[i].y, rects[i].w, rects[i].h);
+        }
+    }
+}
+
+
+static void flush(int x, int y, int w, int h)
+{
+    note_damage(x, y, w, h);
+    display_flush(x, y, w, h);
+}
+
+
+static void flush_rects(const FBRect *rects, int count)
+{
+    for (int i = 0; i < count; i++) {
+        note_damage(rects[i].x, rects[i].y, rects[i].w, rects[i].h);
+    }
+
+    display_flush_list(rects, count);
+}
+
+
+static bool setup_cursor(uint32_t *data, int w, int h, int hot_x, int hot_y)
+{
+    if (w > SOFT_CURSOR_W || h > SOFT_CURSOR_H) {
+        return false;
+    }
+
+    memcpy(sprite, data, w * h * sizeof(uint32_t));
+    sprite_w = w;
+    sprite_h = h;
+    sprite_hot_x = hot_x;
+    sprite_hot_y = hot_y;
+
+    // Draw it on the next commit, wherever it is
+    moved = true;
+    return true;
+}
+
+
+static void move_cursor(int x, int y)
+{
+    if (x != cursor_x || y != cursor_y) {
+        cursor_x = x;
+        cursor_y = y;
+        moved = true;
+    }
+}
+
+
+static void commit_cursor(void)
+{
+    if (!sprite_w || (!moved && !overdrawn)) {
+        return;
+    }
+
+    uint32_t *fb = platform_funcs.fb_back_buffer
+                 ? platform_funcs.fb_back_buffer()
+                 : platform_funcs.framebuffer();
+    int fbw = platform_funcs.fb_width();
+    int fbh = platform_funcs.fb_height();
+    size_t stride = platform_funcs.fb_stride();
+
+    DamageList update;
+    damage_init(&update, fbw, fbh);
+
+    // Take the cursor away where nothing has been drawn over it since
+    // (elsewhere, the save-under is stale anyway)
+    if (drawn) {
+        const DamageRect *r = &drawn_rect;
+        int w = r->xmax - r->xmin;
+
+        for (int y = r->ymin; y < r->ymax; y++) {
+            uint32_t *row = (uint32_t *)((char *)fb + y * stride);
+            int i = (y - r->ymin) * w - r->xmin;
+
+            for (int x = r->xmin; x < r->xmax; x++) {
+                if (!overdrawn_mask[i + x]) {
+                    row[x] = save_under[i + x];
+                }
+            }
+        }
+
+        damage_add(&update, r->xmin, r->ymin, r->xmax, r->ymax);
+    }
+
+    DamageRect r = {
+        .xmin = MAX(cursor_x - sprite_hot_x, 0),
+        .ymin = MAX(cursor_y - sprite_hot_y, 0),
+        .xmax = MIN(cursor_x - sprite_hot_x + sprite_w, fbw),
+        .ymax = MIN(cursor_y - sprite_hot_y + sprite_h, fbh),
+    };
+
+    drawn = r.xmin < r.xmax && r.ymin < r.ymax;
+    if (drawn) {
+        int w = r.xmax - r.xmin;
+
+        for (int y = r.ymin; y < r.ymax; y++) {
+            memcpy(save_under + (y - r.ymin) * w,
+                   (uint32_t *)((char *)fb + y * stride) + r.xmin,
+                   w * sizeof(uint32_t));
+        }
+
+        ablitlmt(fb, sprite, cursor_x - sprite_hot_x, cursor_y - sprite_hot_y,
+                 sprite_w, sprite_h, stride, sprite_w * sizeof(uint32_t),
+                 r.xmin, r.ymin, r.xmax, r.ymax);
+
+        drawn_rect = r;
+        damage_add(&update, r.xmin, r.ymin, r.xmax, r.ymax);
+    }
+
+    memset(overdrawn_mask, 0, sizeof(overdrawn_mask));
+    overdrawn = false;
+
+    FBRect rects[DAMAGE_MAX_RECTS];
+    for (int i = 0; i < update.count; i++) {
+        rects[i] = (FBRect){
+            .x = update.rects[i].xmin,
+            .y = update.rects[i].ymin,
+            .w = update.rects[i].xmax - update.rects[i].xmin,
+            .h = update.rects[i].ymax - update.rects[i].ymin,
+        };
+    }
+    // Not through flush_rects(), this is not drawn over the cursor
+    display_flush_list(rects, update.count);
+
+    moved = false;
+}
+
+
+static bool need_cursor_updates(void)
+{
+    return true;
+}
+
+
+void init_soft_cursor(void)
+{
+    assert(platform_funcs.framebuffer && platform_funcs.fb_flush);
+
+    display_flush = platform_funcs.fb_flush;
+    display_flush_rects = platform_funcs.fb_flush_rects;
+
+    platform_funcs.fb_flush = flush;
+    platform_funcs.fb_flush_rects = flush_rects;
+
+    platform_funcs.setup_cursor = setup_cursor;
+    platform_funcs.move_cursor = move_cursor;
+    platform_funcs.commit_cursor = commit_cursor;
+    platform_funcs.need_cursor_updates = need_cursor_updates;
+
+    puts("[soft-cursor] No cursor plane, drawing the cursor in software");
+}
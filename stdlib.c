@@ -17,6 +17,9 @@ _Noreturn void _abort(void)
                abort_image,
                platform_funcs.fb_height() * platform_funcs.fb_stride());
         platform_funcs.fb_flush(0, 0, 0, 0);
+        if (platform_funcs.fb_present) {
+            platform_funcs.fb_present();
+        }
     }
 
     for (;;);
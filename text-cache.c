@@ -0,0 +1,138 @@
+#include <assert.h>
+#include <blit.h>
+#include <font.h>
+#include <image.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <text-cache.h>
+
+
+// The status column shows a handful of strings at a time; this is
+// enough to keep all of them plus the ones of the previous phase
+#define TEXT_CACHE_ENTRIES 32
+
+
+typedef struct TextCacheEntry {
+    char *text;
+    uint32_t hash;
+    uint32_t color;
+    int width;
+
+    // 0 for unused entries
+    uint64_t last_used;
+
+    SpanImage img;
+} TextCacheEntry;
+
+
+static TextCacheEntry entries[TEXT_CACHE_ENTRIES];
+static uint64_t use_counter;
+static TextCacheStats stats;
+
+
+// FNV-1a
+static uint32_t hash_text(const char *text)
+{
+    uint32_t hash = 0x811c9dc5;
+
+    while (*text) {
+        hash = (hash ^ (uint8_t)*(text++)) * 0x01000193;
+    }
+
+    return hash;
+}
+
+
+static TextCacheEntry *lookup(const char *text, uint32_t hash, uint32_t color,
+                              int width)
+{
+    for (int i = 0; i < TEXT_CACHE_ENTRIES; i++) {
+        TextCacheEntry *e = &entries[i];
+
+        if (e->last_used && e->hash == hash && e->color == color &&
+            e->width == width && !strcmp(e->text, text))
+        {
+            return e;
+        }
+    }
+
+    return NULL;
+}
+
+
+static TextCacheEntry *insert(const char *text, uint32_t hash, uint32_t color,
+                              int width)
+{
+    // Take an unused entry, or evict the least recently used one
+    TextCacheEntry *e = &entries[0];
+    for (int i = 1; i < TEXT_CACHE_ENTRIES && e->last_used; i++) {
+        if (entries[i].last_used < e->last_used) {
+            e = &entries[i];
+        }
+    }
+
+    if (e->last_used) {
+        free(e->text);
+        free_span_image(&e->img);
+        stats.evictions++;
+    }
+
+    size_t len = strlen(text);
+    e->text = malloc(len + 1);
+    memcpy(e->text, text, len + 1);
+    e->hash = hash;
+    e->color = color;
+    e->width = width;
+
+    // Render onto a transparent background with an opaque color, so
+    // span encoding stores only the glyph pixels
+    int height = font_text_height(text, width);
+    size_t stride = width * sizeof(uint32_t);
+    uint32_t *tmp = calloc(height, stride);
+    if (!tmp) {
+        puts("[text-cache] Failed to allocate text buffer");
+        abort();
+    }
+
+    font_draw_text(tmp, width, height, stride, 0, 0, text,
+                   color | 0xff000000);
+    if (!span_encode_image(tmp, width, height, &e->img)) {
+        printf("[text-cache] Failed to encode \"%s\"\n", text);
+        abort();
+    }
+
+    free(tmp);
+
+    return e;
+}
+
+
+void text_cache_draw(uint32_t *output, int owidth, int oheight, size_t ostride,
+                     int x, int y, const char *text, uint32_t text_color)
+{
+    assert(x < owidth && y < oheight);
+
+    int width = owidth - x;
+    uint32_t hash = hash_text(text);
+
+    TextCacheEntry *e = lookup(text, hash, text_color, width);
+    if (e) {
+        stats.hits++;
+    } else {
+        stats.misses++;
+        e = insert(text, hash, text_color, width);
+    }
+
+    e->last_used = ++use_counter;
+
+    sblitlmt(output, &e->img, x, y, ostride, 0, 0, owidth, oheight);
+}
+
+
+void text_cache_get_stats(TextCacheStats *out)
+{
+    *out = stats;
+}
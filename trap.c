@@ -0,0 +1,105 @@
+#include <cpu.h>
+#include <platform.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <trap.h>
+
+
+#define MCAUSE_INTERRUPT (1ul << (sizeof(base_int_t) * 8 - 1))
+
+
+extern void trap_entry(void);
+
+static volatile unsigned interrupts_handled;
+
+
+// Called from trap_entry, which has saved everything we may clobber
+void handle_trap(void);
+
+void handle_trap(void)
+{
+    base_int_t cause = read_csr(CSR_MCAUSE);
+
+    if (!(cause & MCAUSE_INTERRUPT)) {
+        printf("[trap] Exception %zu at %p (mtval %p)\n",
+               (size_t)cause, (void *)read_csr(CSR_MEPC),
+               (void *)read_csr(CSR_MTVAL));
+        abort();
+    }
+
+    switch (cause & ~MCAUSE_INTERRUPT) {
+        case IRQ_M_TIMER:
+            // One-shot; idle_until() arms it again
+            clear_csr_bits(CSR_MIE, MIE_MTIE);
+            break;
+
+        case IRQ_M_EXTERNAL:
+            if (platform_funcs.handle_external_irq) {
+                platform_funcs.handle_external_irq();
+            } else {
+                // Nobody can acknowledge it, so it would come right back
+                clear_csr_bits(CSR_MIE, MIE_MEIE);
+            }
+            break;
+
+        default:
+            printf("[trap] Ignoring interrupt %zu\n",
+                   (size_t)(cause & ~MCAUSE_INTERRUPT));
+            break;
+    }
+
+    interrupts_handled++;
+}
+
+
+void init_trap_secondary(void)
+{
+    write_csr(CSR_MTVEC, (uintptr_t)trap_entry);
+}
+
+
+void init_trap(void)
+{
+    init_trap_secondary();
+
+    set_csr_bits(CSR_MIE, MIE_MEIE);
+    set_csr_bits(CSR_MSTATUS, MSTATUS_MIE);
+}
+
+
+unsigned interrupt_count(void)
+{
+    return interrupts_handled;
+}
+
+
+void wait_for_interrupt(unsigned seen)
+{
+    // wfi also ends for interrupts that are masked in mstatus, so check
+    // and sleep with them masked; whatever woke us is taken right after
+    clear_csr_bits(CSR_MSTATUS, MSTATUS_MIE);
+    if (interrupts_handled == seen) {
+        __asm__ __volatile__ ("wfi" ::: "memory");
+    }
+    set_csr_bits(CSR_MSTATUS, MSTATUS_MIE);
+}
+
+
+void idle_until(uint64_t us)
+{
+    if (!platform_funcs.set_timer) {
+        return;
+    }
+
+    // Before arming the timer, so a deadline that has already passed
+    // does not leave us waiting for the next interrupt
+    unsigned seen = interrupt_count();
+
+    platform_funcs.set_timer(us);
+    set_csr_bits(CSR_MIE, MIE_MTIE);
+
+    wait_for_interrupt(seen);
+}
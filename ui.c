@@ -0,0 +1,197 @@
+#include <assert.h>
+#include <blit.h>
+#include <damage.h>
+#include <nonstddef.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <text-cache.h>
+#include <ui.h>
+
+
+void ui_init(WidgetTree *tree, int x, int y, int w, int h,
+             const uint32_t *bg, int fb_width, int fb_height)
+{
+    *tree = (WidgetTree){
+        .x = x,
+        .y = y,
+        .w = w,
+        .h = h,
+        .dirty = true,
+        .bg = bg,
+        .fb_width = fb_width,
+        .fb_height = fb_height,
+    };
+}
+
+
+void ui_add_widget(WidgetTree *tree, Widget *widget, WidgetType type,
+                   int y, int h)
+{
+    assert(tree->widget_count < UI_MAX_WIDGETS);
+
+    *widget = (Widget){
+        .type = type,
+        .x = tree->x,
+        .y = y,
+        .w = tree->w,
+        .h = h,
+    };
+
+    tree->widgets[tree->widget_count++] = widget;
+}
+
+
+void ui_set_image(Widget *w, const IndexedImage *image)
+{
+    if (w->image == image) {
+        return;
+    }
+
+    w->image = image;
+    w->dirty = true;
+}
+
+
+void ui_set_text(Widget *w, const char *text, uint32_t color)
+{
+    size_t len = MIN(strlen(text), sizeof(w->text) - 1);
+
+    if (w->color == color && !strncmp(w->text, text, len) && !w->text[len]) {
+        return;
+    }
+
+    memcpy(w->text, text, len);
+    w->text[len] = 0;
+    w->color = color;
+    w->dirty = true;
+}
+
+
+void ui_set_icon(Widget *w, const uint32_t *icon, int icon_w, int icon_h)
+{
+    if (w->icon == icon) {
+        return;
+    }
+
+    w->icon = icon;
+    w->icon_w = icon_w;
+    w->icon_h = icon_h;
+    w->dirty = true;
+}
+
+
+void ui_set_overlay(WidgetTree *tree, const uint32_t *overlay)
+{
+    if (tree->overlay == overlay) {
+        return;
+    }
+
+    tree->overlay = overlay;
+    tree->dirty = true;
+}
+
+
+void ui_invalidate(Widget *w)
+{
+    w->dirty = true;
+}
+
+
+static void clear_area(const WidgetTree *tree, uint32_t *fb, size_t stride,
+                       int x, int y, int w, int h)
+{
+    for (int yofs = 0; yofs < h; yofs++) {
+        memcpy((char *)(fb + x) + (y + yofs) * stride,
+               (const char *)(tree->bg + x) + (y + yofs) * stride,
+               w * sizeof(uint32_t));
+    }
+}
+
+
+static void draw_widget(const Widget *w, uint32_t *fb, size_t stride)
+{
+    int xmax = w->x + w->w, ymax = w->y + w->h;
+
+    switch (w->type) {
+        case WIDGET_IMAGE:
+            if (w->image) {
+                iblitlmt(fb, w->image, w->x, w->y, stride,
+                         w->x, w->y, xmax, ymax);
+            }
+            break;
+
+        case WIDGET_TEXT: {
+            if (!w->text[0]) {
+                break;
+            }
+
+            int x = w->x;
+            if (w->icon) {
+                ablitlmt(fb, (uint32_t *)w->icon, x, w->y,
+                         w->icon_w, w->icon_h, stride,
+                         w->icon_w * sizeof(uint32_t),
+                         w->x, w->y, xmax, ymax);
+                x += w->icon_w + 10;
+            }
+
+            if (x < xmax) {
+                text_cache_draw(fb, xmax, ymax, stride, x, w->y, w->text,
+                                w->color);
+            }
+            break;
+        }
+
+        case WIDGET_CUSTOM:
+            w->draw(w, fb, stride);
+            break;
+    }
+}
+
+
+static void draw_overlay(const WidgetTree *tree, uint32_t *fb, size_t stride,
+                         int xmin, int ymin, int xmax, int ymax)
+{
+    if (tree->overlay) {
+        ablitlmt(fb, (uint32_t *)tree->overlay, 0, 0,
+                 tree->fb_width, tree->fb_height, stride,
+                 tree->fb_width * sizeof(uint32_t), xmin, ymin, xmax, ymax);
+    }
+}
+
+
+void ui_render(WidgetTree *tree, uint32_t *fb, size_t stride,
+               DamageList *damage)
+{
+    if (tree->dirty) {
+        clear_area(tree, fb, stride, tree->x, tree->y, tree->w, tree->h);
+
+        for (int i = 0; i < tree->widget_count; i++) {
+            draw_widget(tree->widgets[i], fb, stride);
+            tree->widgets[i]->dirty = false;
+        }
+
+        draw_overlay(tree, fb, stride, tree->x, tree->y,
+                     tree->x + tree->w, tree->y + tree->h);
+        damage_add(damage, tree->x, tree->y,
+                   tree->x + tree->w, tree->y + tree->h);
+
+        tree->dirty = false;
+        return;
+    }
+
+    for (int i = 0; i < tree->widget_count; i++) {
+        Widget *w = tree->widgets[i];
+        if (!w->dirty) {
+            continue;
+        }
+
+        clear_area(tree, fb, stride, w->x, w->y, w->w, w->h);
+        draw_widget(w, fb, stride);
+        draw_overlay(tree, fb, stride, w->x, w->y, w->x + w->w, w->y + w->h);
+        damage_add(damage, w->x, w->y, w->x + w->w, w->y + w->h);
+
+        w->dirty = false;
+    }
+}
@@ -1,5 +1,7 @@
 #include <assert.h>
 #include <config.h>
+#include <damage.h>
+#include <nonstddef.h>
 #include <platform.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -10,7 +12,23 @@
 #include <virtio-gpu.h>
 
 
-#define QUEUE_SIZE 4
+#define QUEUE_SIZE 64
+#define CURSOR_QUEUE_SIZE 4
+
+// With indirect descriptors, every command takes up one ring entry, so
+// the control queue is a ring of (up to) this many command slots.  They
+// may all be in flight at once: Completion is tracked per slot, so it
+// does not matter in which order the device finishes them.
+#define COMMAND_SLOTS QUEUE_SIZE
+
+#ifdef FB_DIFF
+// Granularity at which we detect unchanged framebuffer contents
+#define DIFF_TILE_W 64
+#define DIFF_TILE_H 16
+
+// Print the transfer statistics every this many flushes
+#define DIFF_REPORT_INTERVAL 256
+#endif
 
 // Chosen by virtio-gpu
 #define CURSOR_W 64
@@ -19,38 +37,89 @@
 enum {
     RESOURCE_FB = 1,
     RESOURCE_CURSOR,
+    RESOURCE_FB_BACK,
 };
 
 
 static int fb_width, fb_height;
 
-static _Alignas(4096) uint8_t vq_storage[VirtQTotalSize(QUEUE_SIZE)];
 static VirtQ vq;
-
-static _Alignas(4096) uint8_t cursor_vq_storage[VirtQTotalSize(QUEUE_SIZE)];
 static VirtQ cursor_vq;
 
-static _Alignas(16) union VirtIOGPUCommand gpu_command;
-static _Alignas(16) union VirtIOGPUCommand gpu_command2;
-static _Alignas(16) union VirtIOGPUResponse gpu_response;
-
-static _Alignas(16) struct VirtIOGPUCursorCommand cursor_commands[QUEUE_SIZE];
-
-static uint32_t *framebuffer;
-
-
-static struct VirtIOGPUDisplayInfo *get_display_info(void);
+// Command n (counting from 1) is in slot n % command_slots and has the
+// fence ID n.  The device may complete commands in any order, so every
+// slot is marked done on its own (by the head descriptor of its used
+// element), and completed_fence only advances over the oldest ones that
+// are done: Everything up to it is finished and its slot can be reused,
+// slots are only ever reused oldest first.  Each command
+// goes through its own indirect table (one ring entry per command) if
+// the device supports that, otherwise it takes up two ring entries and
+// only half the slots are used.
+static _Alignas(16) struct {
+    struct VirtQDesc chain[2];
+    union VirtIOGPUCommand cmd;
+    union VirtIOGPUResponse resp;
+    bool done;
+} commands[COMMAND_SLOTS];
+
+static int command_slots;
+
+static uint64_t submitted_fence, kicked_fence, completed_fence;
+
+static _Alignas(16) struct VirtIOGPUCursorCommand
+    cursor_commands[CURSOR_QUEUE_SIZE];
+
+// Last position given to move_cursor() that has not been sent yet
+static bool cursor_move_pending;
+static int cursor_pending_x, cursor_pending_y;
+
+// [0] is RESOURCE_FB, [1] is RESOURCE_FB_BACK (NULL if that could not
+// be created)
+static uint32_t *framebuffers[2];
+static const int fb_resources[2] = { RESOURCE_FB, RESOURCE_FB_BACK };
+
+// Once double buffering is enabled, we draw into framebuffers[back_fb]
+// while the other one is scanned out
+static bool double_buffered;
+static int back_fb;
+// Drawn since the last present
+static DamageList frame_damage;
+// Changed in guest memory since the last transfer to the host
+static DamageList host_stale[2];
+// Last command reading from each of framebuffers[]; it must not be
+// drawn into before that has completed
+static uint64_t fb_fence[2];
+
+#ifdef FB_DIFF
+static int diff_tiles_x, diff_tiles_y;
+// Per entry in framebuffers[], the hash of every tile as it was last
+// transferred to the host (0 if unknown)
+static uint64_t *tile_hashes[2];
+// Per tile, the diff_flushes count during which it was last hashed
+static unsigned *tile_hashed_in;
+static uint64_t diff_requested_bytes, diff_sent_bytes;
+static unsigned diff_flushes;
+
+static void init_tile_diff(void);
+#endif
+
+
+static const struct VirtIOGPUDisplayInfo *get_display_info(void);
 static uint32_t *setup_framebuffer(int scanout, int res_id,
                                    int width, int height);
 static void flush_framebuffer(int x, int y, int width, int height);
+static void flush_framebuffer_rects(const FBRect *rects, int count);
 static size_t framebuffer_stride(void);
 static uint32_t *get_framebuffer(void);
+static uint32_t *get_back_buffer(void);
+static void present(void);
 static int get_framebuffer_width(void);
 static int get_framebuffer_height(void);
 
 static bool setup_cursor(uint32_t *data, int width, int height,
                          int hot_x, int hot_y);
 static void move_cursor(int x, int y);
+static void commit_cursor(void);
 
 static bool need_cursor_updates(void);
 
@@ -63,32 +132,47 @@ void init_virtio_gpu(struct VirtIOControlRegs *regs)
 
     printf("[virtio-gpu] Found device @%p\n", (void *)regs);
 
-    uint64_t features = FF_ANY_LAYOUT | FF_VERSION_1;
+    uint64_t features = FF_ANY_LAYOUT | FF_RING_INDIRECT_LAYOUT |
+                        FF_RING_EVENT_IDX | FF_VERSION_1;
     int ret = virtio_basic_negotiate(regs, &features);
     if (ret < 0) {
         puts("[virtio-gpu] FATAL: Failed to negotiate device features");
         return;
     }
 
-    if (regs->gpu.num_scanouts < 1) {
+    uint32_t generation, num_scanouts;
+    do {
+        generation = virtio_config_generation(regs);
+        num_scanouts = regs->gpu.num_scanouts;
+    } while (generation != virtio_config_generation(regs));
+
+    if (num_scanouts < 1) {
         puts("[virtio-gpu] FATAL: no scanout");
         return;
     }
 
-    if (!vq_init(&vq, 0, &vq_storage, QUEUE_SIZE, regs)) {
+    if (!vq_init(&vq, 0, QUEUE_SIZE, regs)) {
         puts("[virtio-gpu] FATAL: initializing ctrl vq failed");
         return;
     }
 
-    if (!vq_init(&cursor_vq, 1, &cursor_vq_storage, QUEUE_SIZE, regs)) {
+    command_slots = vq.indirect ? COMMAND_SLOTS : QUEUE_SIZE / 2;
+
+    if (!vq_init(&cursor_vq, 1, CURSOR_QUEUE_SIZE, regs)) {
         puts("[virtio-gpu] FATAL: initializing cursor vq failed");
         return;
     }
 
-    regs->status |= DEV_STATUS_DRIVER_OK;
-    __sync_synchronize();
+    // Nothing to do on completion, but waiting for it can sleep then
+    if (vq_enable_interrupts(&vq, NULL)) {
+        vq_enable_interrupts(&cursor_vq, NULL);
+    } else {
+        puts("[virtio-gpu] No interrupts, polling for completion");
+    }
+
+    virtio_driver_ok(regs);
 
-    for (int i = 0; i < QUEUE_SIZE; i++) {
+    for (int i = 0; i < CURSOR_QUEUE_SIZE; i++) {
         vq_push_descriptor(&cursor_vq, &cursor_commands[i],
                            sizeof(struct VirtIOGPUCursorCommand),
                            false, true, true);
@@ -97,13 +181,13 @@ void init_virtio_gpu(struct VirtIOControlRegs *regs)
     cursor_vq.avail_i = 0;
 
 
-    struct VirtIOGPUDisplayInfo *di = get_display_info();
+    const struct VirtIOGPUDisplayInfo *di = get_display_info();
     if (!di) {
         puts("[virtio-gpu] FATAL: Failed to get display info");
         return;
     }
 
-    for (int i = 0; i < (int)regs->gpu.num_scanouts; i++) {
+    for (int i = 0; i < (int)num_scanouts; i++) {
         printf("[virtio-gpu] Scanout %i%s: %ix%i:%ix%i\n",
                 i, i ? " (unsupported)" : "",
                 di->pmodes[i].r.x, di->pmodes[i].r.y,
@@ -111,17 +195,33 @@ void init_virtio_gpu(struct VirtIOControlRegs *regs)
     }
 
 
-    framebuffer = setup_framebuffer(0, RESOURCE_FB, di->pmodes[0].r.width,
-                                    di->pmodes[0].r.height);
-    if (!framebuffer) {
+    // @di points into a command slot, which is about to be reused
+    fb_width = di->pmodes[0].r.width;
+    fb_height = di->pmodes[0].r.height;
+
+    framebuffers[0] = setup_framebuffer(0, RESOURCE_FB, fb_width, fb_height);
+    if (!framebuffers[0]) {
         puts("[virtio-gpu] FATAL: Failed setting up framebuffer");
+        return;
     }
 
-    fb_width = di->pmodes[0].r.width;
-    fb_height = di->pmodes[0].r.height;
+    printf("[virtio-gpu] Framebuffer set up @%p\n", (void *)framebuffers[0]);
+
+    framebuffers[1] = setup_framebuffer(-1, RESOURCE_FB_BACK,
+                                        fb_width, fb_height);
+    if (framebuffers[1]) {
+        printf("[virtio-gpu] Back buffer set up @%p\n",
+               (void *)framebuffers[1]);
 
+        platform_funcs.fb_back_buffer = get_back_buffer;
+        platform_funcs.fb_present = present;
+    } else {
+        puts("[virtio-gpu] No back buffer, double buffering unavailable");
+    }
 
-    printf("[virtio-gpu] Framebuffer set up @%p\n", (void *)framebuffer);
+#ifdef FB_DIFF
+    init_tile_diff();
+#endif
 
 
     platform_funcs.framebuffer = get_framebuffer;
@@ -129,9 +229,11 @@ void init_virtio_gpu(struct VirtIOControlRegs *regs)
     platform_funcs.fb_height = get_framebuffer_height;
     platform_funcs.fb_stride = framebuffer_stride;
     platform_funcs.fb_flush = flush_framebuffer;
+    platform_funcs.fb_flush_rects = flush_framebuffer_rects;
 
     platform_funcs.setup_cursor = setup_cursor;
     platform_funcs.move_cursor = move_cursor;
+    platform_funcs.commit_cursor = commit_cursor;
     platform_funcs.need_cursor_updates = need_cursor_updates;
 }
 
@@ -143,41 +245,143 @@ static bool need_cursor_updates(void)
 }
 
 
-static bool exec_command(void)
+// Marks the command the device has put into used element @used_idx as
+// done, then advances completed_fence as far as possible
+static void complete_command(uint16_t used_idx)
 {
-    vq_push_descriptor(&vq, &gpu_command, sizeof(gpu_command),
-                       false, true, false);
+    // Slot n always starts at descriptor n * (descriptors per command)
+    int descs_per_command = QUEUE_SIZE / command_slots;
+    uint32_t desc = vq_used_id(&vq, used_idx);
+    uint32_t slot = desc / descs_per_command;
+
+    if (desc % descs_per_command || slot >= (uint32_t)command_slots ||
+        commands[slot].done)
+    {
+        printf("[virtio-gpu] Ignoring bogus completion (descriptor %u)\n",
+               (unsigned)desc);
+        return;
+    }
 
-    vq_push_descriptor(&vq, &gpu_response, sizeof(gpu_response),
-                       true, false, true);
+    commands[slot].done = true;
 
-    vq_exec(&vq);
-    vq_wait_used(&vq);
+    while (completed_fence < submitted_fence &&
+           commands[completed_fence % command_slots].done)
+    {
+        completed_fence++;
+    }
+}
+
+
+// Collects everything the device has completed so far, without waiting
+static void reap_commands(void)
+{
+    int used_idx;
+
+    while ((used_idx = vq_single_poll_used(&vq)) >= 0) {
+        complete_command(used_idx);
+    }
+}
+
+
+// Lets the device know about everything submitted so far
+static void kick_commands(void)
+{
+    if (kicked_fence != submitted_fence) {
+        vq_exec(&vq);
+        kicked_fence = submitted_fence;
+    }
+}
+
+
+static void wait_fence(uint64_t fence)
+{
+    kick_commands();
+    reap_commands();
+
+    while (completed_fence < fence) {
+        for (uint16_t i = vq_wait_used(&vq); i != vq.used_i; i++) {
+            complete_command(i);
+        }
+    }
+}
+
+
+// Returns the next command slot to fill in, waiting for the oldest
+// command to complete if the ring is full
+static union VirtIOGPUCommand *begin_command(void)
+{
+    reap_commands();
+
+    if (submitted_fence - completed_fence == (uint64_t)command_slots) {
+        wait_fence(completed_fence + 1);
+    }
 
-    return gpu_response.hdr.type >= VIRTIO_GPU_RESP_OK_NODATA &&
-           gpu_response.hdr.type <  VIRTIO_GPU_RESP_ERR_UNSPEC;
+    return &commands[submitted_fence % command_slots].cmd;
 }
 
 
-static struct VirtIOGPUDisplayInfo *get_display_info(void)
+// Queues the command filled into the slot from begin_command() (@size
+// bytes of it), but does not notify the device yet.  Returns its fence.
+static uint64_t submit_command(size_t size)
 {
-    vq_wait_settled(&vq);
-    gpu_command.hdr.type = VIRTIO_GPU_CMD_GET_DISPLAY_INFO;
-    exec_command();
-    if (gpu_response.hdr.type != VIRTIO_GPU_RESP_OK_DISPLAY_INFO) {
+    int slot = submitted_fence % command_slots;
+    uint64_t fence = ++submitted_fence;
+
+    commands[slot].done = false;
+    commands[slot].cmd.hdr.flags |= VIRTIO_GPU_FLAG_FENCE;
+    commands[slot].cmd.hdr.fence_id = fence;
+
+    vq_set_indirect(commands[slot].chain, 0, 2, &commands[slot].cmd, size,
+                    false);
+    vq_set_indirect(commands[slot].chain, 1, 2, &commands[slot].resp,
+                    sizeof(commands[slot].resp), true);
+    vq_push_indirect(&vq, commands[slot].chain, 2);
+
+    return fence;
+}
+
+
+// Submits the command from begin_command() and waits for it; returns
+// its response if it succeeded, NULL otherwise
+static const union VirtIOGPUResponse *exec_command(size_t size)
+{
+    const union VirtIOGPUResponse *resp =
+        &commands[submitted_fence % command_slots].resp;
+
+    wait_fence(submit_command(size));
+
+    if (resp->hdr.type < VIRTIO_GPU_RESP_OK_NODATA ||
+        resp->hdr.type >= VIRTIO_GPU_RESP_ERR_UNSPEC)
+    {
+        return NULL;
+    }
+    return resp;
+}
+
+
+static const struct VirtIOGPUDisplayInfo *get_display_info(void)
+{
+    union VirtIOGPUCommand *cmd = begin_command();
+
+    cmd->hdr = (struct VirtIOGPUCtrlHdr){
+        .type = VIRTIO_GPU_CMD_GET_DISPLAY_INFO,
+    };
+
+    const union VirtIOGPUResponse *resp = exec_command(sizeof(cmd->hdr));
+    if (!resp || resp->hdr.type != VIRTIO_GPU_RESP_OK_DISPLAY_INFO) {
         return NULL;
     }
 
-    return &gpu_response.display_info;
+    return &resp->display_info;
 }
 
 
 static bool create_2d_resource(int id, enum VirtIOGPUFormats format,
                                int width, int height)
 {
-    vq_wait_settled(&vq);
+    union VirtIOGPUCommand *cmd = begin_command();
 
-    gpu_command.res_create_2d = (struct VirtIOGPUResourceCreate2D){
+    cmd->res_create_2d = (struct VirtIOGPUResourceCreate2D){
         .hdr = {
             .type = VIRTIO_GPU_CMD_RESOURCE_CREATE_2D,
         },
@@ -187,15 +391,15 @@ static bool create_2d_resource(int id, enum VirtIOGPUFormats format,
         .height = height,
     };
 
-    return exec_command();
+    return exec_command(sizeof(cmd->res_create_2d));
 }
 
 
 static bool resource_attach_backing(int id, uintptr_t address, size_t length)
 {
-    vq_wait_settled(&vq);
+    union VirtIOGPUCommand *cmd = begin_command();
 
-    gpu_command.res_attach_backing = (struct VirtIOGPUResourceAttachBacking){
+    cmd->res_attach_backing = (struct VirtIOGPUResourceAttachBacking){
         .hdr = {
             .type = VIRTIO_GPU_CMD_RESOURCE_ATTACH_BACKING,
         },
@@ -203,20 +407,19 @@ static bool resource_attach_backing(int id, uintptr_t address, size_t length)
         .nr_entries = 1,
     };
 
-    gpu_command.res_attach_backing.entries[0] = (struct VirtIOGPUMemEntry){
+    cmd->res_attach_backing.entries[0] = (struct VirtIOGPUMemEntry){
         .addr = address,
         .length = length,
     };
 
-    return exec_command();
+    return exec_command(sizeof(cmd->res_attach_backing));
 }
 
 
-static bool set_scanout(int scanout, int res_id, int width, int height)
+static void fill_scanout(struct VirtIOGPUSetScanout *cmd, int scanout,
+                         int res_id, int width, int height)
 {
-    vq_wait_settled(&vq);
-
-    gpu_command.set_scanout = (struct VirtIOGPUSetScanout){
+    *cmd = (struct VirtIOGPUSetScanout){
         .hdr = {
             .type = VIRTIO_GPU_CMD_SET_SCANOUT,
         },
@@ -227,8 +430,16 @@ static bool set_scanout(int scanout, int res_id, int width, int height)
         .scanout_id = scanout,
         .resource_id = res_id,
     };
+}
+
+
+static bool set_scanout(int scanout, int res_id, int width, int height)
+{
+    union VirtIOGPUCommand *cmd = begin_command();
+
+    fill_scanout(&cmd->set_scanout, scanout, res_id, width, height);
 
-    return exec_command();
+    return exec_command(sizeof(cmd->set_scanout));
 }
 
 
@@ -255,13 +466,20 @@ static uint32_t *setup_framebuffer(int scanout, int res_id,
         return NULL;
     }
 
-    if (!set_scanout(scanout, res_id, width, height)) {
+    // Negative @scanout: Do not scan this out yet
+    if (scanout >= 0 && !set_scanout(scanout, res_id, width, height)) {
         return NULL;
     }
 
     size_t stride = calc_stride(width, 32);
     uint32_t *fb = memalign(PAGESIZE, height * stride);
+    if (!fb) {
+        puts("[virtio-gpu] Failed to allocate framebuffer memory");
+        return NULL;
+    }
+
     if (!resource_attach_backing(res_id, (uintptr_t)fb, height * stride)) {
+        free(fb);
         return NULL;
     }
 
@@ -269,65 +487,363 @@ static uint32_t *setup_framebuffer(int scanout, int res_id,
 }
 
 
-static void flush_framebuffer(int x, int y, int width, int height)
+static void fill_transfer(struct VirtIOGPUTransferToHost2D *cmd, int res_id,
+                          const FBRect *r)
 {
-    if (width <= 0) {
-        width = fb_width;
-    }
-    if (height <= 0) {
-        height = fb_height;
-    }
-
-    vq_wait_settled(&vq);
-
-    gpu_command.transfer_to_host_2d = (struct VirtIOGPUTransferToHost2D){
+    *cmd = (struct VirtIOGPUTransferToHost2D){
         .hdr = {
             .type = VIRTIO_GPU_CMD_TRANSFER_TO_HOST_2D,
         },
         .r = {
-            .x = x,
-            .y = y,
-            .width = width,
-            .height = height,
+            .x = r->x,
+            .y = r->y,
+            .width = r->w,
+            .height = r->h,
         },
-        .offset = y * framebuffer_stride() + x * 4,
-        .resource_id = RESOURCE_FB,
+        .offset = r->y * framebuffer_stride() + r->x * 4,
+        .resource_id = res_id,
     };
+}
 
-    gpu_command2.res_flush = (struct VirtIOGPUResourceFlush){
+static void fill_flush(struct VirtIOGPUResourceFlush *cmd, int res_id,
+                       const FBRect *r)
+{
+    *cmd = (struct VirtIOGPUResourceFlush){
         .hdr = {
             .type = VIRTIO_GPU_CMD_RESOURCE_FLUSH,
         },
         .r = {
-            .x = x,
-            .y = y,
-            .width = width,
-            .height = height,
+            .x = r->x,
+            .y = r->y,
+            .width = r->w,
+            .height = r->h,
         },
-        .resource_id = RESOURCE_FB,
+        .resource_id = res_id,
+    };
+}
+
+// w/h of 0 mean the whole framebuffer width/height
+static FBRect full_rect(const FBRect *r)
+{
+    return (FBRect){
+        .x = r->x,
+        .y = r->y,
+        .w = r->w > 0 ? r->w : fb_width,
+        .h = r->h > 0 ? r->h : fb_height,
+    };
+}
+
+
+// Queue a command without notifying the device; return its fence
+static uint64_t submit_transfer(int res_id, const FBRect *r)
+{
+    union VirtIOGPUCommand *cmd = begin_command();
+    fill_transfer(&cmd->transfer_to_host_2d, res_id, r);
+    return submit_command(sizeof(cmd->transfer_to_host_2d));
+}
+
+static uint64_t submit_flush(int res_id, const FBRect *r)
+{
+    union VirtIOGPUCommand *cmd = begin_command();
+    fill_flush(&cmd->res_flush, res_id, r);
+    return submit_command(sizeof(cmd->res_flush));
+}
+
+
+#ifdef FB_DIFF
+static void init_tile_diff(void)
+{
+    diff_tiles_x = DIV_ROUND_UP(fb_width, DIFF_TILE_W);
+    diff_tiles_y = DIV_ROUND_UP(fb_height, DIFF_TILE_H);
+
+    for (int i = 0; i < 2; i++) {
+        tile_hashes[i] = calloc(diff_tiles_x * diff_tiles_y,
+                                sizeof(tile_hashes[i][0]));
+    }
+    tile_hashed_in = calloc(diff_tiles_x * diff_tiles_y,
+                            sizeof(tile_hashed_in[0]));
+
+    printf("[virtio-gpu] Diffing %ix%i tiles before transfers\n",
+           DIFF_TILE_W, DIFF_TILE_H);
+}
+
+
+// Rehashes the given tile of framebuffers[@fbi], returns whether it
+// differs from what was last transferred
+static bool update_tile(int fbi, int tx, int ty)
+{
+    size_t stride = framebuffer_stride();
+    int x = tx * DIFF_TILE_W, y = ty * DIFF_TILE_H;
+    int w = MIN(DIFF_TILE_W, fb_width - x);
+    int h = MIN(DIFF_TILE_H, fb_height - y);
+
+    // FNV-1a over whole pixels
+    uint64_t hash = 0xcbf29ce484222325;
+    const uint32_t *row = (const uint32_t *)((char *)framebuffers[fbi]
+                                             + y * stride) + x;
+    for (int yofs = 0; yofs < h; yofs++) {
+        for (int xofs = 0; xofs < w; xofs++) {
+            hash = (hash ^ row[xofs]) * 0x100000001b3;
+        }
+        row = (const uint32_t *)((const char *)row + stride);
+    }
+    // Never 0, so unknown tiles always count as changed
+    hash |= 1;
+
+    tile_hashed_in[ty * diff_tiles_x + tx] = diff_flushes;
+
+    uint64_t *stored = &tile_hashes[fbi][ty * diff_tiles_x + tx];
+    if (*stored == hash) {
+        return false;
+    }
+
+    *stored = hash;
+    return true;
+}
+
+
+// Reduces @rects to the tiles in them that changed since they were
+// last transferred to framebuffers[@fbi]'s resource, coalesced into at
+// most DAMAGE_MAX_RECTS rectangles in @out.  Returns how many there
+// are (@out may be @rects).  The hashes of all tiles in @out are
+// updated, so the caller must transfer all of it.
+static int diff_rects(int fbi, const FBRect *rects, int count, FBRect *out)
+{
+    DamageList changed;
+    damage_init(&changed, fb_width, fb_height);
+
+    // Identifies the tiles hashed during this call
+    diff_flushes++;
+
+    uint64_t requested = 0;
+
+    for (int i = 0; i < count; i++) {
+        FBRect r = rects[i];
+        if (r.w <= 0) {
+            r.w = fb_width;
+        }
+        if (r.h <= 0) {
+            r.h = fb_height;
+        }
+        requested += (uint64_t)r.w * r.h * sizeof(uint32_t);
+
+        int tx_start = r.x / DIFF_TILE_W;
+        int tx_end = MIN(DIV_ROUND_UP(r.x + r.w, DIFF_TILE_W), diff_tiles_x);
+        int ty_start = r.y / DIFF_TILE_H;
+        int ty_end = MIN(DIV_ROUND_UP(r.y + r.h, DIFF_TILE_H), diff_tiles_y);
+
+        // Changed tiles are transferred whole so the hashes always
+        // describe what the host has; runs of them make one rectangle
+        for (int ty = ty_start; ty < ty_end; ty++) {
+            int run_start = -1;
+
+            for (int tx = tx_start; tx <= tx_end; tx++) {
+                bool dirty = tx < tx_end && update_tile(fbi, tx, ty);
+
+                if (dirty && run_start < 0) {
+                    run_start = tx;
+                } else if (!dirty && run_start >= 0) {
+                    damage_add(&changed,
+                               run_start * DIFF_TILE_W, ty * DIFF_TILE_H,
+                               tx * DIFF_TILE_W, (ty + 1) * DIFF_TILE_H);
+                    run_start = -1;
+                }
+            }
+        }
+    }
+
+    uint64_t sent = 0;
+    for (int i = 0; i < changed.count; i++) {
+        const DamageRect *dr = &changed.rects[i];
+
+        // Coalescing may have merged in tiles that were not requested
+        // or not dirty; they are transferred too, so their hashes must
+        // match what they are now
+        for (int ty = dr->ymin / DIFF_TILE_H;
+             ty < DIV_ROUND_UP(dr->ymax, DIFF_TILE_H); ty++)
+        {
+            for (int tx = dr->xmin / DIFF_TILE_W;
+                 tx < DIV_ROUND_UP(dr->xmax, DIFF_TILE_W); tx++)
+            {
+                if (tile_hashed_in[ty * diff_tiles_x + tx] != diff_flushes) {
+                    update_tile(fbi, tx, ty);
+                }
+            }
+        }
+
+        out[i] = (FBRect){
+            .x = dr->xmin,
+            .y = dr->ymin,
+            .w = dr->xmax - dr->xmin,
+            .h = dr->ymax - dr->ymin,
+        };
+        sent += (uint64_t)out[i].w * out[i].h * sizeof(uint32_t);
+    }
+
+    diff_requested_bytes += requested;
+    diff_sent_bytes += sent;
+    if (diff_flushes % DIFF_REPORT_INTERVAL == 0) {
+        printf("[virtio-gpu] Transferred %zu of %zu KiB (%zu KiB saved)\n",
+               (size_t)(diff_sent_bytes >> 10),
+               (size_t)(diff_requested_bytes >> 10),
+               (size_t)((diff_requested_bytes - diff_sent_bytes) >> 10));
+    }
+
+    return changed.count;
+}
+#endif
+
+
+static void flush_framebuffer(int x, int y, int width, int height)
+{
+    FBRect rect = {
+        .x = x,
+        .y = y,
+        .w = width,
+        .h = height,
     };
 
-    vq_push_descriptor(&vq, &gpu_command, sizeof(gpu_command),
-                       false, true, false);
+    flush_framebuffer_rects(&rect, 1);
+}
 
-    vq_push_descriptor(&vq, &gpu_response, sizeof(gpu_response),
-                       true, false, true);
 
-    vq_push_descriptor(&vq, &gpu_command2, sizeof(gpu_command2),
-                       false, true, false);
+static void flush_framebuffer_rects(const FBRect *rects, int count)
+{
+    if (double_buffered) {
+        // Only remember what to show on the next present()
+        for (int i = 0; i < count; i++) {
+            int width = rects[i].w > 0 ? rects[i].w : fb_width;
+            int height = rects[i].h > 0 ? rects[i].h : fb_height;
+
+            damage_add(&frame_damage, rects[i].x, rects[i].y,
+                       rects[i].x + width, rects[i].y + height);
+        }
+        return;
+    }
 
-    // We don't care about the result anyway, might as well just
-    // overwrite the previous one
-    vq_push_descriptor(&vq, &gpu_response, sizeof(gpu_response),
-                       true, false, true);
+#ifdef FB_DIFF
+    FBRect changed[DAMAGE_MAX_RECTS];
+    count = diff_rects(0, rects, count, changed);
+    rects = changed;
+#endif
+
+    // All transfers first, then all flushes, then one notification;
+    // nothing waits for the device unless the command ring is full
+    for (int i = 0; i < count; i++) {
+        FBRect r = full_rect(&rects[i]);
+        submit_transfer(RESOURCE_FB, &r);
+    }
+    for (int i = 0; i < count; i++) {
+        FBRect r = full_rect(&rects[i]);
+        submit_flush(RESOURCE_FB, &r);
+    }
 
-    vq_exec(&vq);
+    kick_commands();
+}
+
+
+static uint32_t *get_back_buffer(void)
+{
+    if (!double_buffered) {
+        // Switch to double buffering: Both buffers start out with the
+        // same content, but the back buffer's resource has never been
+        // transferred
+        wait_fence(submitted_fence);
+
+        memcpy(framebuffers[1], framebuffers[0],
+               fb_height * framebuffer_stride());
+
+        damage_init(&frame_damage, fb_width, fb_height);
+        damage_init(&host_stale[0], fb_width, fb_height);
+        damage_init(&host_stale[1], fb_width, fb_height);
+        damage_add(&host_stale[1], 0, 0, fb_width, fb_height);
+
+        back_fb = 1;
+        double_buffered = true;
+    }
+
+    return framebuffers[back_fb];
+}
+
+
+static void present(void)
+{
+    if (!double_buffered || !frame_damage.count) {
+        return;
+    }
+
+    int front_fb = !back_fb;
+    DamageList *stale = &host_stale[back_fb];
+
+    for (int i = 0; i < frame_damage.count; i++) {
+        const DamageRect *r = &frame_damage.rects[i];
+        damage_add(stale, r->xmin, r->ymin, r->xmax, r->ymax);
+    }
+
+    FBRect transfers[DAMAGE_MAX_RECTS];
+    int transfer_count = stale->count;
+    for (int i = 0; i < stale->count; i++) {
+        const DamageRect *r = &stale->rects[i];
+        transfers[i] = (FBRect){
+            .x = r->xmin,
+            .y = r->ymin,
+            .w = r->xmax - r->xmin,
+            .h = r->ymax - r->ymin,
+        };
+    }
+
+#ifdef FB_DIFF
+    transfer_count = diff_rects(back_fb, transfers, transfer_count, transfers);
+#endif
+
+    // Bring the back buffer's resource up to date, scan it out, and
+    // have the host redraw; all in one go
+    for (int i = 0; i < transfer_count; i++) {
+        submit_transfer(fb_resources[back_fb], &transfers[i]);
+    }
+
+    union VirtIOGPUCommand *cmd = begin_command();
+    fill_scanout(&cmd->set_scanout, 0, fb_resources[back_fb],
+                 fb_width, fb_height);
+    submit_command(sizeof(cmd->set_scanout));
+
+    fb_fence[back_fb] = submit_flush(fb_resources[back_fb],
+                                     &(FBRect){ .w = fb_width,
+                                                .h = fb_height });
+
+    kick_commands();
+
+    damage_init(stale, fb_width, fb_height);
+
+    // Flip.  Once the host is done with what the previous present()
+    // sent from the new back buffer (which will usually be the case by
+    // now), we can bring it up to date with what was drawn into the
+    // other one in the meantime while the host works on the new front.
+    wait_fence(fb_fence[front_fb]);
+
+    size_t stride = framebuffer_stride();
+    for (int i = 0; i < frame_damage.count; i++) {
+        const DamageRect *r = &frame_damage.rects[i];
+
+        for (int y = r->ymin; y < r->ymax; y++) {
+            memcpy((char *)framebuffers[front_fb] + y * stride
+                       + r->xmin * sizeof(uint32_t),
+                   (char *)framebuffers[back_fb] + y * stride
+                       + r->xmin * sizeof(uint32_t),
+                   (r->xmax - r->xmin) * sizeof(uint32_t));
+        }
+
+        damage_add(&host_stale[front_fb], r->xmin, r->ymin, r->xmax, r->ymax);
+    }
+
+    damage_init(&frame_damage, fb_width, fb_height);
+    back_fb = front_fb;
 }
 
 
 static uint32_t *get_framebuffer(void)
 {
-    return framebuffer;
+    return framebuffers[double_buffered ? back_fb : 0];
 }
 
 static int get_framebuffer_width(void)
@@ -374,26 +890,16 @@ static bool setup_cursor(uint32_t *data, int width, int height,
         return false;
     }
 
-    vq_wait_settled(&vq);
-
-    gpu_command.transfer_to_host_2d = (struct VirtIOGPUTransferToHost2D){
-        .hdr = {
-            .type = VIRTIO_GPU_CMD_TRANSFER_TO_HOST_2D,
-        },
-        .r = {
-            .width = CURSOR_W,
-            .height = CURSOR_H,
-        },
-        .resource_id = RESOURCE_CURSOR,
-    };
-
-    if (!exec_command()) {
+    union VirtIOGPUCommand *cmd = begin_command();
+    fill_transfer(&cmd->transfer_to_host_2d, RESOURCE_CURSOR,
+                  &(FBRect){ .w = CURSOR_W, .h = CURSOR_H });
+    if (!exec_command(sizeof(cmd->transfer_to_host_2d))) {
         return false;
     }
 
     vq_wait_settled(&cursor_vq);
 
-    int desc_i = cursor_vq.avail_i++ % QUEUE_SIZE;
+    int desc_i = cursor_vq.avail_i++ % CURSOR_QUEUE_SIZE;
     cursor_commands[desc_i] = (struct VirtIOGPUCursorCommand){
         .hdr = {
             .type = VIRTIO_GPU_CMD_UPDATE_CURSOR,
@@ -414,17 +920,41 @@ static bool setup_cursor(uint32_t *data, int width, int height,
 
 static void move_cursor(int x, int y)
 {
-    vq_wait_settled(&cursor_vq);
+    // Only sent by commit_cursor(), so any number of moves per frame
+    // cost one command
+    cursor_move_pending = true;
+    cursor_pending_x = x;
+    cursor_pending_y = y;
+}
+
+
+static void commit_cursor(void)
+{
+    // Reap whatever the device has completed so far, without waiting
+    while (vq_single_poll_used(&cursor_vq) >= 0);
+
+    if (!cursor_move_pending) {
+        return;
+    }
+
+    // All commands still in flight: Keep the position pending and try
+    // again next frame instead of stalling this one
+    uint16_t in_flight = cursor_vq.avail_i - cursor_vq.used_i;
+    if (in_flight >= CURSOR_QUEUE_SIZE) {
+        return;
+    }
+
+    cursor_move_pending = false;
 
-    int desc_i = cursor_vq.avail_i++ % QUEUE_SIZE;
+    int desc_i = cursor_vq.avail_i++ % CURSOR_QUEUE_SIZE;
     cursor_commands[desc_i] = (struct VirtIOGPUCursorCommand){
         .hdr = {
             .type = VIRTIO_GPU_CMD_MOVE_CURSOR,
         },
         .pos = {
             .scanout_id = 0,
-            .x = x,
-            .y = y,
+            .x = cursor_pending_x,
+            .y = cursor_pending_y,
         },
         // I leave it up to you whether the "spec" (the documentation
         // in the reference header) or qemu's implementation is buggy,
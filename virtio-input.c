@@ -27,10 +27,14 @@ static const char *const dev_name[DEVICE_COUNT] = {
 #define QUEUE_SIZE 8
 
 
-static _Alignas(4096) struct {
-    _Alignas(4096) uint8_t vq_storage[VirtQTotalSize(QUEUE_SIZE)];
+static struct {
     _Alignas(16) struct VirtIOInputEvent evt[QUEUE_SIZE];
     VirtQ vq;
+
+    // Without interrupts, we have to look at the queue every time;
+    // otherwise, only once the interrupt handler has set @pending
+    bool polled;
+    bool pending;
 } devs[DEVICE_COUNT];
 
 static int pointing_x, pointing_y;
@@ -39,6 +43,7 @@ static int tablet_min[2], tablet_max[2];
 
 
 static void init_device(struct VirtIOControlRegs *regs, enum Device dev);
+static void events_arrived(VirtQ *vq);
 
 static void select_config(struct VirtIOControlRegs *regs,
                           int select, int subsel)
@@ -49,62 +54,92 @@ static void select_config(struct VirtIOControlRegs *regs,
     __sync_synchronize();
 }
 
+
+// Selects @select/@subsel and copies what the device has there to
+// @cfg; returns its size (0 if the device has nothing there)
+static int read_config(struct VirtIOControlRegs *regs, int select, int subsel,
+                       struct VirtIOInputConfig *cfg)
+{
+    uint32_t generation;
+
+    select_config(regs, select, subsel);
+
+    do {
+        generation = virtio_config_generation(regs);
+
+        cfg->size = regs->input.size;
+
+        if (select == VIRTIO_INPUT_CFG_ABS_INFO) {
+            cfg->abs.min = regs->input.abs.min;
+            cfg->abs.max = regs->input.abs.max;
+        } else {
+            for (int i = 0; i < cfg->size; i++) {
+                cfg->bitmap[i] = regs->input.bitmap[i];
+            }
+        }
+    } while (generation != virtio_config_generation(regs));
+
+    return cfg->size;
+}
+
 void init_virtio_input(struct VirtIOControlRegs *regs)
 {
     printf("[virtio-input] Found device @%p\n", (void *)regs);
 
-    uint64_t features = FF_ANY_LAYOUT | FF_VERSION_1;
+    uint64_t features = FF_ANY_LAYOUT | FF_RING_EVENT_IDX | FF_VERSION_1;
     int ret = virtio_basic_negotiate(regs, &features);
     if (ret < 0) {
         puts("[virtio-input] FATAL: Failed to negotiate device features");
         return;
     }
 
-    select_config(regs, VIRTIO_INPUT_CFG_ID_NAME, 0);
-
-    printf("[virtio-input] %s", regs->input.string);
+    struct VirtIOInputConfig cfg;
 
-    select_config(regs, VIRTIO_INPUT_CFG_EV_BITS, VIRTIO_INPUT_CESS_KEY);
+    int len = read_config(regs, VIRTIO_INPUT_CFG_ID_NAME, 0, &cfg);
+    cfg.string[MIN(len, (int)sizeof(cfg.string) - 1)] = '\0';
+    printf("[virtio-input] %s", cfg.string);
 
     int keys = 0, axes = 0;
     bool mouse_axes = false, tablet_axes = false;
 
-    if (regs->input.select) {
-        for (int i = 0; i < regs->input.size * 8; i++) {
-            if (regs->input.bitmap[i / 8] & (1 << (i % 8))) {
+    if (read_config(regs, VIRTIO_INPUT_CFG_EV_BITS, VIRTIO_INPUT_CESS_KEY,
+                    &cfg))
+    {
+        for (int i = 0; i < cfg.size * 8; i++) {
+            if (cfg.bitmap[i / 8] & (1 << (i % 8))) {
                 keys++;
             }
         }
         printf(", %i keys", keys);
     }
 
-    select_config(regs, VIRTIO_INPUT_CFG_EV_BITS, VIRTIO_INPUT_CESS_REL);
-
-    if (regs->input.select) {
-        for (int i = 0; i < regs->input.size * 8; i++) {
-            if (regs->input.bitmap[i / 8] & (1 << (i % 8))) {
+    if (read_config(regs, VIRTIO_INPUT_CFG_EV_BITS, VIRTIO_INPUT_CESS_REL,
+                    &cfg))
+    {
+        for (int i = 0; i < cfg.size * 8; i++) {
+            if (cfg.bitmap[i / 8] & (1 << (i % 8))) {
                 axes++;
             }
         }
         printf(", %i rel. axes", axes);
 
         if (axes) {
-            mouse_axes = (regs->input.bitmap[0] & 3) == 3;
+            mouse_axes = (cfg.bitmap[0] & 3) == 3;
         }
     }
 
-    select_config(regs, VIRTIO_INPUT_CFG_EV_BITS, VIRTIO_INPUT_CESS_ABS);
-
-    if (regs->input.select) {
-        for (int i = 0; i < regs->input.size * 8; i++) {
-            if (regs->input.bitmap[i / 8] & (1 << (i % 8))) {
+    if (read_config(regs, VIRTIO_INPUT_CFG_EV_BITS, VIRTIO_INPUT_CESS_ABS,
+                    &cfg))
+    {
+        for (int i = 0; i < cfg.size * 8; i++) {
+            if (cfg.bitmap[i / 8] & (1 << (i % 8))) {
                 axes++;
             }
         }
         printf(", %i abs. axes", axes);
 
         if (axes) {
-            tablet_axes = (regs->input.bitmap[0] & 3) == 3;
+            tablet_axes = (cfg.bitmap[0] & 3) == 3;
         }
     }
 
@@ -143,28 +178,30 @@ static void init_device(struct VirtIOControlRegs *regs, enum Device dev)
 
     if (dev == TABLET) {
         for (int axis = 0; axis < 2; axis++) {
-            select_config(regs, VIRTIO_INPUT_CFG_ABS_INFO, axis);
-            if (!regs->input.select) {
+            struct VirtIOInputConfig cfg;
+
+            if (!read_config(regs, VIRTIO_INPUT_CFG_ABS_INFO, axis, &cfg)) {
                 printf("[virtio-input] FATAL: Failed to get %c axis info\n",
                        axis ? 'Y' : 'X');
                 goto fail;
             }
 
-            tablet_min[axis] = regs->input.abs.min;
-            tablet_max[axis] = regs->input.abs.max;
+            tablet_min[axis] = cfg.abs.min;
+            tablet_max[axis] = cfg.abs.max;
         }
     }
 
     select_config(regs, VIRTIO_INPUT_CFG_UNSET, 0);
 
-    if (!vq_init(&devs[dev].vq, 0, &devs[dev].vq_storage, QUEUE_SIZE, regs)) {
+    if (!vq_init(&devs[dev].vq, 0, QUEUE_SIZE, regs)) {
         printf("[virtio-input] FATAL: Failed to initialize %s vq\n",
                 dev_name[dev]);
         goto fail;
     }
 
-    regs->status |= DEV_STATUS_DRIVER_OK;
-    __sync_synchronize();
+    devs[dev].polled = !vq_enable_interrupts(&devs[dev].vq, events_arrived);
+
+    virtio_driver_ok(regs);
 
     for (int i = 0; i < QUEUE_SIZE; i++) {
         vq_push_descriptor(&devs[dev].vq, &devs[dev].evt[i],
@@ -229,13 +266,35 @@ static int saturated_add(int x, int y, int min, int max)
 }
 
 
+// Runs in the interrupt handler
+static void events_arrived(VirtQ *vq)
+{
+    for (enum Device dev = 0; dev < DEVICE_COUNT; dev++) {
+        if (&devs[dev].vq == vq) {
+            __atomic_store_n(&devs[dev].pending, true, __ATOMIC_RELEASE);
+        }
+    }
+}
+
+
 static bool get_device_event(enum Device dev, struct VirtIOInputEvent *evt)
 {
+    // Cleared before looking, so an interrupt in between just makes us
+    // look once more next time
+    if (!devs[dev].polled &&
+        !__atomic_exchange_n(&devs[dev].pending, false, __ATOMIC_ACQUIRE))
+    {
+        return false;
+    }
+
     int ret = vq_single_poll_used(&devs[dev].vq);
     if (ret < 0) {
         return false;
     }
 
+    // There may be more
+    devs[dev].pending = true;
+
     *evt = devs[dev].evt[ret % QUEUE_SIZE];
 
     devs[dev].vq.avail_i++;
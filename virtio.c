@@ -1,9 +1,13 @@
 #include <assert.h>
 #include <config.h>
+#include <platform.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <trap.h>
 #include <virtio.h>
 #include <virtio-gpu.h>
 #include <virtio-input.h>
@@ -12,7 +16,35 @@
 #define STR_TO_U32(str) (*(uint32_t *)str)
 
 
-void init_virtio_device(struct VirtIOControlRegs *regs)
+// Per device, the virtqueues to look at when it raises an interrupt
+static struct VirtIODevice {
+    volatile struct VirtIOControlRegs *regs;
+    int irq;
+    bool irq_registered;
+    uint64_t features; // As negotiated
+
+    int vq_count;
+    VirtQ *vqs[VIRTIO_MAX_IRQ_QUEUES];
+} devices[VIRTIO_MAX_DEVICES];
+
+static int device_count;
+
+static VirtIOStats stats;
+
+
+static struct VirtIODevice *find_device(volatile struct VirtIOControlRegs *regs)
+{
+    for (int i = 0; i < device_count; i++) {
+        if (devices[i].regs == regs) {
+            return &devices[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+void init_virtio_device(struct VirtIOControlRegs *regs, int irq)
 {
     assert(regs->magic == STR_TO_U32("virt"));
 
@@ -24,6 +56,13 @@ void init_virtio_device(struct VirtIOControlRegs *regs)
         return;
     }
 
+    if (device_count < VIRTIO_MAX_DEVICES) {
+        devices[device_count++] = (struct VirtIODevice){
+            .regs = regs,
+            .irq = irq,
+        };
+    }
+
     switch (regs->device_id) {
         case DEVID_INPUT:
             init_virtio_input(regs);
@@ -41,6 +80,11 @@ int virtio_basic_negotiate(struct VirtIOControlRegs *regs, uint64_t *features)
     regs->status = DEV_STATUS_RESET;
     __sync_synchronize();
 
+    // The reset is only done once the device says so
+    while (regs->status != DEV_STATUS_RESET) {
+        __asm__ __volatile__ ("" ::: "memory");
+    }
+
     regs->status |= DEV_STATUS_ACKNOWLEDGE;
     __sync_synchronize();
 
@@ -59,16 +103,31 @@ int virtio_basic_negotiate(struct VirtIOControlRegs *regs, uint64_t *features)
 
     *features &= offered_features;
 
-    regs->device_features_sel = 0;
-    __sync_synchronize();
-    regs->device_features = (uint32_t)*features;
-    __sync_synchronize();
-    regs->device_features_sel = 1;
+    // The modern transport cannot be driven the legacy way
+    if (regs->version >= 2 && !(*features & FF_VERSION_1)) {
+        regs->status |= DEV_STATUS_FAILED;
+        return -1;
+    }
+
+    regs->driver_features_sel = 0;
     __sync_synchronize();
-    regs->device_features = (uint32_t)(*features >> 32);
+    regs->driver_features = (uint32_t)*features;
     __sync_synchronize();
 
-    if (regs->version < 2 || !(*features & FF_VERSION_1)) {
+    // Legacy devices only have the low half
+    if (regs->version >= 2) {
+        regs->driver_features_sel = 1;
+        __sync_synchronize();
+        regs->driver_features = (uint32_t)(*features >> 32);
+        __sync_synchronize();
+    }
+
+    struct VirtIODevice *dev = find_device(regs);
+    if (dev) {
+        dev->features = *features;
+    }
+
+    if (regs->version < 2) {
         regs->legacy_guest_page_size = PAGESIZE;
     } else {
         regs->status |= DEV_STATUS_FEATURES_OK;
@@ -76,6 +135,7 @@ int virtio_basic_negotiate(struct VirtIOControlRegs *regs, uint64_t *features)
         __sync_synchronize();
 
         if (!(regs->status & DEV_STATUS_FEATURES_OK)) {
+            regs->status |= DEV_STATUS_FAILED;
             return -1;
         }
     }
@@ -84,26 +144,38 @@ int virtio_basic_negotiate(struct VirtIOControlRegs *regs, uint64_t *features)
 }
 
 
-bool vq_init(VirtQ *vq, int queue_index, void *base, int queue_size,
-             volatile struct VirtIOControlRegs *regs)
+void virtio_driver_ok(struct VirtIOControlRegs *regs)
 {
-    *vq = (VirtQ){
-        .base = base,
-        .queue_index = queue_index,
-        .queue_size = queue_size,
-        .regs = regs,
-    };
+    // Everything about the virtqueues must be visible to the device
+    // before it may start using them
+    __sync_synchronize();
+    regs->status |= DEV_STATUS_DRIVER_OK;
+    __sync_synchronize();
+}
 
-    uint64_t features;
 
-    regs->device_features_sel = 0;
-    features = regs->device_features;
-    regs->device_features_sel = 1;
-    features |= (uint64_t)regs->device_features << 32;
+uint32_t virtio_config_generation(volatile struct VirtIOControlRegs *regs)
+{
+    // Legacy devices do not have this register (and have no way to
+    // tell us about concurrent config changes)
+    if (regs->version < 2) {
+        return 0;
+    }
+
+    uint32_t generation = regs->config_generation;
+    __sync_synchronize();
+    return generation;
+}
 
-    bool legacy = regs->version < 2 || !(features & FF_VERSION_1);
+
+bool vq_init(VirtQ *vq, int queue_index, int queue_size,
+             volatile struct VirtIOControlRegs *regs)
+{
+    struct VirtIODevice *dev = find_device(regs);
+    bool legacy = regs->version < 2;
 
     regs->queue_sel = queue_index;
+    __sync_synchronize();
 
     if (legacy ? regs->legacy_queue_pfn : regs->queue_ready) {
         puts("[virtio] virtqueue is already in use");
@@ -115,36 +187,98 @@ bool vq_init(VirtQ *vq, int queue_index, void *base, int queue_size,
         return false;
     }
 
-    regs->queue_num = queue_size;
+    // The modern transport takes each part's address separately, so
+    // they only need their natural alignment.  The legacy one only
+    // takes a page number and puts the used ring on the next page
+    // boundary after the avail ring.
+    size_t align = legacy ? PAGESIZE : _Alignof(struct VirtQDesc);
+    size_t avail_offset = sizeof(struct VirtQDesc) * queue_size;
+    size_t used_offset = ROUND_UP(avail_offset +
+                                  offsetof(VirtQAvail(1), ring) +
+                                  sizeof(uint16_t) * (queue_size + 1),
+                                  legacy ? PAGESIZE : 4);
+    size_t total = used_offset + offsetof(VirtQUsed(1), ring) +
+                   sizeof(((VirtQUsed(1) *)NULL)->ring[0]) * queue_size +
+                   sizeof(uint16_t);
+
+    void *base = memalign(align, total);
+    if (!base) {
+        puts("[virtio] Failed to allocate virtqueue");
+        return false;
+    }
+    memset(base, 0, total);
+
+    *vq = (VirtQ){
+        .base = base,
+        .avail = (void *)((uintptr_t)base + avail_offset),
+        .used = (void *)((uintptr_t)base + used_offset),
+        .queue_index = queue_index,
+        .queue_size = queue_size,
+        .regs = regs,
+        .event_idx = dev && (dev->features & FF_RING_EVENT_IDX),
+        .indirect = dev && (dev->features & FF_RING_INDIRECT_LAYOUT),
+    };
 
-    VirtQAvail(1) *avail = (void *)((uintptr_t)base +
-                                    sizeof(struct VirtQDesc) * queue_size);
+    VirtQAvail(1) *avail = vq->avail;
     avail->flags = VQAF_NO_INTERRUPT;
 
+    regs->queue_num = queue_size;
+
     if (legacy) {
         regs->legacy_queue_align = PAGESIZE;
+        __sync_synchronize();
         regs->legacy_queue_pfn = (uintptr_t)base / PAGESIZE;
     } else {
-        uintptr_t vq_desc = (uintptr_t)base;
-        regs->queue_desc_lo = (uint32_t)(uintptr_t)&vq_desc;
-        regs->queue_desc_lo = (uint32_t)((uintptr_t)&vq_desc >> 32);
+        regs->queue_desc_lo = (uint32_t)(uintptr_t)base;
+        regs->queue_desc_hi = (uint32_t)((uint64_t)(uintptr_t)base >> 32);
 
-        uintptr_t vq_avail = (uintptr_t)avail;
-        regs->queue_avail_lo = (uint32_t)(uintptr_t)&vq_avail;
-        regs->queue_avail_lo = (uint32_t)((uintptr_t)&vq_avail >> 32);
+        regs->queue_avail_lo = (uint32_t)(uintptr_t)vq->avail;
+        regs->queue_avail_hi =
+            (uint32_t)((uint64_t)(uintptr_t)vq->avail >> 32);
 
-        uintptr_t vq_used = (uintptr_t)base +
-            ROUND_UP(sizeof(struct VirtQDesc) * queue_size +
-                     sizeof(VirtQAvail(1)) + sizeof(uint16_t) * queue_size,
-                     PAGESIZE);
-        regs->queue_used_lo = (uint32_t)(uintptr_t)&vq_used;
-        regs->queue_used_lo = (uint32_t)((uintptr_t)&vq_used >> 32);
+        regs->queue_used_lo = (uint32_t)(uintptr_t)vq->used;
+        regs->queue_used_hi = (uint32_t)((uint64_t)(uintptr_t)vq->used >> 32);
+
+        __sync_synchronize();
+        regs->queue_ready = 1;
     }
 
+    __sync_synchronize();
+
     return true;
 }
 
 
+// Where the avail ring ends, we tell the device after which used entry
+// to interrupt us next
+static volatile uint16_t *vq_used_event(VirtQ *vq)
+{
+    return (void *)((uintptr_t)vq->avail + offsetof(VirtQAvail(1), ring) +
+                    sizeof(uint16_t) * vq->queue_size);
+}
+
+
+// Where the used ring ends, the device tells us after which avail entry
+// to notify it next
+static volatile uint16_t *vq_avail_event(VirtQ *vq)
+{
+    return (void *)((uintptr_t)vq->used + offsetof(VirtQUsed(1), ring) +
+                    sizeof(((VirtQUsed(1) *)NULL)->ring[0]) * vq->queue_size);
+}
+
+
+// Asks for an interrupt once the device has used the entry at @idx (and
+// not before); the caller checks the used ring again afterwards, in
+// case the device got there first
+static void vq_arm_used_event(VirtQ *vq, uint16_t idx)
+{
+    if (vq->event_idx) {
+        *vq_used_event(vq) = idx;
+        __sync_synchronize();
+    }
+}
+
+
 void vq_push_descriptor(VirtQ *vq, void *ptr, size_t length,
                         bool write, bool first, bool last)
 {
@@ -160,10 +294,8 @@ void vq_push_descriptor(VirtQ *vq, void *ptr, size_t length,
     };
 
     if (first) {
-        uint16_t *avail_ring =
-            (void *)((uintptr_t)vq->base +
-                     sizeof(struct VirtQDesc) * vq->queue_size +
-                     offsetof(VirtQAvail(1), ring));
+        VirtQAvail(1) *avail = vq->avail;
+        uint16_t *avail_ring = avail->ring;
 
         avail_ring[vq->avail_i++ % vq->queue_size] = vq->desc_i % vq->queue_size;
     }
@@ -172,39 +304,107 @@ void vq_push_descriptor(VirtQ *vq, void *ptr, size_t length,
 }
 
 
+void vq_set_indirect(struct VirtQDesc *table, int i, int count,
+                     void *ptr, size_t length, bool write)
+{
+    bool last = i == count - 1;
+
+    table[i] = (struct VirtQDesc){
+        .addr = (uintptr_t)ptr,
+        .len = length,
+        .flags = (last ? 0 : VQDF_NEXT) | (write ? VQDF_WRITE : 0),
+        .next = last ? 0 : i + 1,
+    };
+}
+
+
+void vq_push_indirect(VirtQ *vq, struct VirtQDesc *table, int count)
+{
+    if (!vq->indirect) {
+        for (int i = 0; i < count; i++) {
+            vq_push_descriptor(vq, (void *)(uintptr_t)table[i].addr,
+                               table[i].len, table[i].flags & VQDF_WRITE,
+                               i == 0, i == count - 1);
+        }
+        return;
+    }
+
+    struct VirtQDesc *vqdesc = vq->base;
+    VirtQAvail(1) *avail = vq->avail;
+    uint16_t *avail_ring = avail->ring;
+
+    int desc = vq->desc_i++ % vq->queue_size;
+
+    vqdesc[desc] = (struct VirtQDesc){
+        .addr = (uintptr_t)table,
+        .len = sizeof(*table) * count,
+        .flags = VQDF_INDIRECT,
+    };
+
+    avail_ring[vq->avail_i++ % vq->queue_size] = desc;
+}
+
+
 void vq_exec(VirtQ *vq)
 {
     __sync_synchronize();
 
-    VirtQAvail(1) *avail = (void *)((uintptr_t)vq->base +
-                                    sizeof(struct VirtQDesc) * vq->queue_size);
+    VirtQAvail(1) *avail = vq->avail;
     avail->idx = vq->avail_i;
 
     __sync_synchronize();
     __asm__ __volatile__ ("" ::: "memory");
 
-    VirtQUsed(1) *used = (void *)((uintptr_t)vq->base +
-            ROUND_UP(sizeof(struct VirtQDesc) * vq->queue_size +
-                     sizeof(VirtQAvail(1)) + sizeof(uint16_t) * vq->queue_size,
-                     PAGESIZE));
+    VirtQUsed(1) *used = vq->used;
+
+    uint16_t old = vq->kicked_i, new = vq->avail_i;
+    vq->kicked_i = new;
+
+    bool notify;
+    if (vq->event_idx) {
+        // Only if the device wants to hear about one of the entries
+        // we have added since the last time
+        uint16_t event = *vq_avail_event(vq);
+        notify = (uint16_t)(new - event - 1) < (uint16_t)(new - old);
+    } else {
+        notify = !(used->flags & VQUF_NO_NOTIFY);
+    }
 
-    if (!(used->flags & VQUF_NO_NOTIFY)) {
+    if (notify) {
         vq->regs->queue_notify = vq->queue_index;
+        stats.notifications++;
+    } else {
+        stats.suppressed_notifications++;
+    }
+}
+
+
+// Waits for the device to do something with @vq (or for any other
+// interrupt) if it interrupts us; otherwise, the caller just spins
+static void vq_idle(VirtQ *vq, unsigned seen)
+{
+    if (vq->interrupts) {
+        wait_for_interrupt(seen);
+    } else {
+        __asm__ __volatile__ ("" ::: "memory");
     }
 }
 
 
 uint16_t vq_wait_used(VirtQ *vq)
 {
-    VirtQUsed(1) *used = (void *)((uintptr_t)vq->base +
-            ROUND_UP(sizeof(struct VirtQDesc) * vq->queue_size +
-                     sizeof(VirtQAvail(1)) + sizeof(uint16_t) * vq->queue_size,
-                     PAGESIZE));
+    VirtQUsed(1) *used = vq->used;
 
     uint16_t next = vq->used_i;
 
-    while (used->idx == vq->used_i) {
-        __asm__ __volatile__ ("" ::: "memory");
+    vq_arm_used_event(vq, vq->used_i);
+
+    for (;;) {
+        unsigned seen = interrupt_count();
+        if (used->idx != vq->used_i) {
+            break;
+        }
+        vq_idle(vq, seen);
     }
 
     vq->used_i = used->idx;
@@ -215,17 +415,32 @@ uint16_t vq_wait_used(VirtQ *vq)
 }
 
 
+uint32_t vq_used_id(VirtQ *vq, uint16_t used_idx)
+{
+    const uint32_t *elem =
+        (void *)((uintptr_t)vq->used + offsetof(VirtQUsed(1), ring) +
+                 sizeof(((VirtQUsed(1) *)NULL)->ring[0]) *
+                 (used_idx % vq->queue_size));
+
+    // .id comes first
+    return elem[0];
+}
+
+
 int vq_single_poll_used(VirtQ *vq)
 {
-    VirtQUsed(1) *used = (void *)((uintptr_t)vq->base +
-            ROUND_UP(sizeof(struct VirtQDesc) * vq->queue_size +
-                     sizeof(VirtQAvail(1)) + sizeof(uint16_t) * vq->queue_size,
-                     PAGESIZE));
+    VirtQUsed(1) *used = vq->used;
 
     uint16_t next = vq->used_i;
 
     if (used->idx == vq->used_i) {
-        return -1;
+        // Drained, so we want to hear about the next one again (until
+        // then, the device does not need to interrupt us)
+        vq_arm_used_event(vq, vq->used_i);
+
+        if (!vq->event_idx || used->idx == vq->used_i) {
+            return -1;
+        }
     }
 
     vq->used_i++;
@@ -238,16 +453,76 @@ int vq_single_poll_used(VirtQ *vq)
 
 void vq_wait_settled(VirtQ *vq)
 {
-    VirtQUsed(1) *used = (void *)((uintptr_t)vq->base +
-            ROUND_UP(sizeof(struct VirtQDesc) * vq->queue_size +
-                     sizeof(VirtQAvail(1)) + sizeof(uint16_t) * vq->queue_size,
-                     PAGESIZE));
+    VirtQUsed(1) *used = vq->used;
 
-    while (used->idx != vq->avail_i) {
-        __asm__ __volatile__ ("" ::: "memory");
+    // Nothing before the last one is interesting
+    vq_arm_used_event(vq, vq->avail_i - 1);
+
+    for (;;) {
+        unsigned seen = interrupt_count();
+        if (used->idx == vq->avail_i) {
+            break;
+        }
+        vq_idle(vq, seen);
     }
 
     vq->used_i = used->idx;
 
     __sync_synchronize();
 }
+
+
+static void handle_device_irq(void *opaque)
+{
+    struct VirtIODevice *dev = opaque;
+
+    // Acknowledge first, so we do not miss anything that comes in while
+    // we look at the queues
+    uint32_t status = dev->regs->interrupt_status;
+    dev->regs->interrupt_ack = status;
+    __sync_synchronize();
+
+    for (int i = 0; i < dev->vq_count; i++) {
+        VirtQ *vq = dev->vqs[i];
+        VirtQUsed(1) *used = vq->used;
+
+        if (vq->callback && used->idx != vq->used_i) {
+            vq->callback(vq);
+        }
+    }
+}
+
+
+bool vq_enable_interrupts(VirtQ *vq, VirtQCallback callback)
+{
+    struct VirtIODevice *dev = find_device(vq->regs);
+
+    if (!dev || !dev->irq || !platform_funcs.register_irq ||
+        dev->vq_count == VIRTIO_MAX_IRQ_QUEUES)
+    {
+        return false;
+    }
+
+    if (!dev->irq_registered) {
+        if (!platform_funcs.register_irq(dev->irq, handle_device_irq, dev)) {
+            return false;
+        }
+        dev->irq_registered = true;
+    }
+
+    vq->callback = callback;
+    vq->interrupts = true;
+    dev->vqs[dev->vq_count++] = vq;
+
+    VirtQAvail(1) *avail = vq->avail;
+    avail->flags &= ~VQAF_NO_INTERRUPT;
+    __sync_synchronize();
+
+    return true;
+}
+
+
+void virtio_get_stats(VirtIOStats *out)
+{
+    *out = stats;
+}